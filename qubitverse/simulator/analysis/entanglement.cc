@@ -0,0 +1,147 @@
+/**
+ * @file entanglement.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./entanglement.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace simulator
+{
+    void entanglement::embed(const rdm &__rho, real8 &__out, const bool &conjugate)
+    {
+        const double sign = conjugate ? -1.0 : 1.0;
+        for (std::size_t r = 0; r < 4; r++)
+            for (std::size_t c = 0; c < 4; c++)
+            {
+                const double re = __rho[4 * r + c].real(), im = sign * __rho[4 * r + c].imag();
+                __out[r][c] = __out[r + 4][c + 4] = re;
+                __out[r][c + 4] = -im;
+                __out[r + 4][c] = im;
+            }
+    }
+
+    void entanglement::jacobi(real8 &__a, real8 &__v, double (&__w)[8])
+    {
+        for (std::size_t r = 0; r < 8; r++)
+            for (std::size_t c = 0; c < 8; c++)
+                __v[r][c] = r == c ? 1.0 : 0.0;
+
+        // cyclic sweeps of plane rotations until the off-diagonal part is negligible
+        for (std::size_t sweep = 0; sweep < 64; sweep++)
+        {
+            double off = 0.0;
+            for (std::size_t p = 0; p < 8; p++)
+                for (std::size_t q = p + 1; q < 8; q++)
+                    off += __a[p][q] * __a[p][q];
+            if (off < 1.0E-30)
+                break;
+
+            for (std::size_t p = 0; p < 8; p++)
+                for (std::size_t q = p + 1; q < 8; q++)
+                {
+                    if (std::abs(__a[p][q]) < 1.0E-300)
+                        continue;
+                    const double theta = (__a[q][q] - __a[p][p]) / (2.0 * __a[p][q]);
+                    const double t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                    const double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+                    for (std::size_t k = 0; k < 8; k++)
+                    {
+                        const double akp = __a[k][p], akq = __a[k][q];
+                        __a[k][p] = c * akp - s * akq;
+                        __a[k][q] = s * akp + c * akq;
+                    }
+                    for (std::size_t k = 0; k < 8; k++)
+                    {
+                        const double apk = __a[p][k], aqk = __a[q][k];
+                        __a[p][k] = c * apk - s * aqk;
+                        __a[q][k] = s * apk + c * aqk;
+                    }
+                    for (std::size_t k = 0; k < 8; k++)
+                    {
+                        const double vkp = __v[k][p], vkq = __v[k][q];
+                        __v[k][p] = c * vkp - s * vkq;
+                        __v[k][q] = s * vkp + c * vkq;
+                    }
+                }
+        }
+        for (std::size_t k = 0; k < 8; k++)
+            __w[k] = __a[k][k];
+    }
+
+    double entanglement::entropy_2x2(const complex &a, const complex &b, const complex &d)
+    {
+        // eigenvalues of [[a, b], [conj(b), d]]
+        const double tr = a.real() + d.real(), diff = a.real() - d.real();
+        const double root = std::sqrt(diff * diff + 4.0 * std::norm(b));
+        double s = 0.0;
+        for (const double l : {(tr + root) / 2.0, (tr - root) / 2.0})
+            if (l > 1.0E-15)
+                s -= l * std::log2(l);
+        return s;
+    }
+
+    double entanglement::concurrence(const rdm &__rho)
+    {
+        // sqrt(rho), from the eigen-decomposition of its real form
+        real8 a, v, root = {};
+        double w[8];
+        embed(__rho, a, false);
+        jacobi(a, v, w);
+        for (std::size_t r = 0; r < 8; r++)
+            for (std::size_t c = 0; c < 8; c++)
+                for (std::size_t k = 0; k < 8; k++)
+                    root[r][c] += v[r][k] * std::sqrt(std::max(w[k], 0.0)) * v[c][k];
+
+        // rho~ = (Y x Y) conj(rho) (Y x Y), Y x Y only permutes entries and flips signs: it maps |00> <-> -|11>, |01> <-> |10>
+        static constexpr std::size_t flip[4] = {3, 2, 1, 0};
+        static constexpr double sign[4] = {-1.0, 1.0, 1.0, -1.0};
+        rdm tilde;
+        for (std::size_t r = 0; r < 4; r++)
+            for (std::size_t c = 0; c < 4; c++)
+                tilde[4 * r + c] = sign[r] * sign[c] * __rho[4 * flip[r] + flip[c]];
+        real8 t, tmp = {}, m = {};
+        embed(tilde, t, true);
+
+        // eigenvalues of sqrt(rho) rho~ sqrt(rho) are the squares of the ones Wootters' formula needs
+        for (std::size_t r = 0; r < 8; r++)
+            for (std::size_t c = 0; c < 8; c++)
+                for (std::size_t k = 0; k < 8; k++)
+                    tmp[r][c] += root[r][k] * t[k][c];
+        for (std::size_t r = 0; r < 8; r++)
+            for (std::size_t c = 0; c < 8; c++)
+                for (std::size_t k = 0; k < 8; k++)
+                    m[r][c] += tmp[r][k] * root[k][c];
+        jacobi(m, v, w);
+
+        // every eigenvalue appears twice in the real form, keep one of each pair, round-off sized ones count as 0 (their
+        // square roots would otherwise show up as ~1e-8)
+        std::sort(w, w + 8, std::greater<double>());
+        double l[4];
+        for (std::size_t k = 0; k < 4; k++)
+            l[k] = w[2 * k] > 1.0E-14 ? std::sqrt(w[2 * k]) : 0.0;
+        return std::max(0.0, l[0] - l[1] - l[2] - l[3]);
+    }
+
+    double entanglement::mutual_information(const rdm &__rho)
+    {
+        real8 a, v;
+        double w[8];
+        embed(__rho, a, false);
+        jacobi(a, v, w);
+        double s_ab = 0.0;
+        for (const double l : w)
+            if (l > 1.0E-15)
+                s_ab -= l * std::log2(l);
+        s_ab /= 2.0;
+
+        // partial traces: the first qubit is bit 0 of the index, the second bit 1
+        const double s_a = entropy_2x2(__rho[0] + __rho[10], __rho[1] + __rho[11], __rho[5] + __rho[15]);
+        const double s_b = entropy_2x2(__rho[0] + __rho[5], __rho[2] + __rho[7], __rho[10] + __rho[15]);
+        return std::max(0.0, s_a + s_b - s_ab);
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * @file entanglement.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_ENTANGLEMENT
+#define SIMULATOR_ENTANGLEMENT
+
+#include <array>
+#include <complex>
+
+namespace simulator
+{
+    // figures of merit of a two-qubit reduced density matrix, the 4x4 matrices are small enough for a dense Jacobi solver:
+    // a complex Hermitian matrix H = A + iB is handled as the real symmetric [[A, -B], [B, A]], which has the same eigenvalues,
+    // each twice, and commutes with taking square roots
+    class entanglement
+    {
+      public:
+        using complex = std::complex<double>;
+        // row-major 4x4 density matrix, row/column index = bit of the first qubit | bit of the second qubit << 1
+        using rdm = std::array<complex, 16>;
+
+      private:
+        using real8 = double[8][8];
+
+        static void embed(const rdm &__rho, real8 &__out, const bool &conjugate);
+        // eigenvalues (ascending) and eigenvectors (columns of `__v`) of a real symmetric matrix, `__a` is destroyed
+        static void jacobi(real8 &__a, real8 &__v, double (&__w)[8]);
+        static double entropy_2x2(const complex &a, const complex &b, const complex &d);
+
+      public:
+        // Wootters concurrence, 0 for separable states and 1 for Bell states
+        [[nodiscard]] static double concurrence(const rdm &__rho);
+        // S(A) + S(B) - S(AB) in bits, 2 for Bell states
+        [[nodiscard]] static double mutual_information(const rdm &__rho);
+    };
+}
+
+#endif
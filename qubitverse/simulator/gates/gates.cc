@@ -5,12 +5,19 @@
  */
 
 #include "./gates.hh"
+#include "../kernels/kernels.hh"
+#include "../threading/thread_pool.hh"
+#include "../memory/allocator.hh"
+#include "../memory/buffer_pool.hh"
+
+#include <algorithm>
+#include <bit>
 
 namespace simulator
 {
-    void qubit::apply_predefined_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const std::size_t &qubit_target)
+    template <typename T>
+    void basic_qubit<T>::apply_predefined_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const std::size_t &qubit_target)
     {
-        const std::size_t stride = 1ULL << qubit_target; // Distance between paired indices
         std::size_t g_index;
         if (__g_type == gate_type::SQRT_OF_X_V)
             g_index = 7;
@@ -19,24 +26,24 @@ namespace simulator
         else
             g_index = static_cast<std::size_t>(__g_type);
 
-        for (std::size_t i = 0; i < _len; i += 2 * stride)
-        {
-            for (std::size_t j = 0; j < stride; ++j)
-            {
-                std::size_t idx0 = i + j;
-                std::size_t idx1 = i + j + stride;
-
-                // Apply the gate to the two elements
-                complex a = __s[idx0];
-                complex b = __s[idx1];
+        if (__g_type == gate_type::PAULI_X)
+            kernels::apply_pauli_x(__s, _len, qubit_target);
+        else
+            basic_qubit::apply_matrix(__s, _len, pre_defined_qgates[g_index].matrix, qubit_target);
+    }
 
-                __s[idx0] = pre_defined_qgates[g_index].matrix[0][0] * a + pre_defined_qgates[g_index].matrix[0][1] * b;
-                __s[idx1] = pre_defined_qgates[g_index].matrix[1][0] * a + pre_defined_qgates[g_index].matrix[1][1] * b;
-            }
-        }
+    template <typename T>
+    void basic_qubit<T>::apply_matrix(complex *&__s, const std::size_t &_len, const gate_complex (&__m)[2][2], const std::size_t &qubit_target)
+    {
+        const complex m[2][2] = {{complex(__m[0][0]), complex(__m[0][1])}, {complex(__m[1][0]), complex(__m[1][1])}};
+        if (__m[0][1] == 0.0 && __m[1][0] == 0.0)
+            kernels::apply_diagonal(__s, _len, m[0][0], m[1][1], qubit_target);
+        else
+            kernels::apply_2x2(__s, _len, m, qubit_target);
     }
 
-    qubit::qgate_2x2 &qubit::get_theta_gate(qgate_2x2 &__g, const gate_type &__g_type, const double &__theta)
+    template <typename T>
+    typename basic_qubit<T>::qgate_2x2 &basic_qubit<T>::get_theta_gate(qgate_2x2 &__g, const gate_type &__g_type, const double &__theta)
     {
         __g.type = __g_type;
         switch (__g_type)
@@ -50,8 +57,8 @@ namespace simulator
 
         case gate_type::ROTATION_X:
             __g.matrix[0][0] = std::cos<double>(__theta / 2.0);
-            __g.matrix[0][1] = (complex){0.0, -1.0} * std::sin<double>(__theta / 2.0);
-            __g.matrix[1][0] = (complex){0.0, -1.0} * std::sin<double>(__theta / 2.0);
+            __g.matrix[0][1] = (gate_complex){0.0, -1.0} * std::sin<double>(__theta / 2.0);
+            __g.matrix[1][0] = (gate_complex){0.0, -1.0} * std::sin<double>(__theta / 2.0);
             __g.matrix[1][1] = std::cos<double>(__theta / 2.0);
             break;
 
@@ -76,86 +83,67 @@ namespace simulator
         return __g;
     }
 
-    void qubit::apply_theta_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const double &__theta, const std::size_t &qubit_target)
+    template <typename T>
+    void basic_qubit<T>::apply_theta_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const double &__theta, const std::size_t &qubit_target)
     {
-        const std::size_t stride = 1ULL << qubit_target; // Distance between paired indices
         qgate_2x2 __g;
-        __g = qubit::get_theta_gate(__g, __g_type, __theta);
-
-        for (std::size_t i = 0; i < _len; i += 2 * stride)
-        {
-            for (std::size_t j = 0; j < stride; ++j)
-            {
-                std::size_t idx0 = i + j;
-                std::size_t idx1 = i + j + stride;
-
-                // Apply the gate to the two elements
-                complex a = __s[idx0];
-                complex b = __s[idx1];
-
-                __s[idx0] = __g.matrix[0][0] * a + __g.matrix[0][1] * b;
-                __s[idx1] = __g.matrix[1][0] * a + __g.matrix[1][1] * b;
-            }
-        }
+        __g = basic_qubit::get_theta_gate(__g, __g_type, __theta);
+        basic_qubit::apply_matrix(__s, _len, __g.matrix, qubit_target);
     }
 
-    void qubit::apply_2qubit_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const std::size_t &q_control, const std::size_t &q_target)
+    template <typename T>
+    void basic_qubit<T>::check_2qubit_gate(const std::size_t &_len, const std::size_t &q_control, const std::size_t &q_target)
     {
         if (std::log2(_len) < 2.0)
         {
             std::fprintf(stderr, "error: specified gate operation requires a minimum of 2 qubit-system, but it was %zu qubit-system.\n", (std::size_t)std::log2(_len));
             std::exit(EXIT_FAILURE);
         }
-
-        if (__g_type == gate_type::CONTROLLED_NOT)
+        if (q_control == q_target)
         {
-            for (std::size_t i = 0; i < _len; i++)
-            {
-                if ((i & (1ULL << q_control)) != 0)
-                { // If control qubit is 1
-                    std::size_t target_bit_flipped_index = i ^ (1ULL << q_target);
-                    // Only swap once per pair.
-                    if (i < target_bit_flipped_index)
-                    {
-                        std::swap(__s[i], __s[target_bit_flipped_index]);
-                    }
-                }
-            }
+            std::fprintf(stderr, "error: two-qubit gate requires two distinct qubits, but both were qubit %zu.\n", q_control);
+            std::exit(EXIT_FAILURE);
         }
+    }
+
+    template <typename T>
+    void basic_qubit<T>::apply_2qubit_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const std::size_t &q_control, const std::size_t &q_target)
+    {
+        basic_qubit::check_2qubit_gate(_len, q_control, q_target);
+
+        if (__g_type == gate_type::CONTROLLED_NOT)
+            kernels::apply_cnot(__s, _len, q_control, q_target);
         else if (__g_type == gate_type::CONTROLLED_Z)
-        {
-            for (std::size_t i = 0; i < _len; i++)
-            {
-                if (((i >> q_control) & 1) && ((i >> q_target) & 1))
-                {
-                    __s[i] *= -1;
-                }
-            }
-        }
+            kernels::apply_cz(__s, _len, q_control, q_target);
         else if (__g_type == gate_type::SWAP_GATE)
-        {
-            for (std::size_t i = 0; i < _len; ++i)
-            {
-                // Extract the bits at positions q_control and q_target.
-                const std::size_t bit_q1 = (i >> q_control) & 1;
-                const std::size_t bit_q2 = (i >> q_target) & 1;
+            kernels::apply_swap(__s, _len, q_control, q_target);
+    }
 
-                // Only need to swap if the bits differ.
-                if (bit_q1 != bit_q2)
-                {
-                    // Flip the bits at q_control and q_target.
-                    std::size_t j = i ^ ((1ULL << q_control) | (1ULL << q_target));
-                    // To avoid double swapping, swap only if i < j.
-                    if (i < j)
-                    {
-                        std::swap(__s[i], __s[j]);
-                    }
-                }
-            }
-        }
+    template <typename T>
+    std::shared_ptr<typename basic_qubit<T>::complex> basic_qubit<T>::allocate_state(const std::size_t &_len, const complex *__src)
+    {
+        // a pooled buffer is reset by the same parallel fill that first touches a fresh one
+        const std::size_t bytes = sizeof(complex) * _len;
+        void *p = buffer_pool::get().acquire(bytes);
+        if (__src)
+            allocator::copy(p, __src, bytes);
+        else
+            allocator::first_touch(p, bytes);
+        return std::shared_ptr<complex>(static_cast<complex *>(p), [bytes](complex *__s)
+                                        { buffer_pool::get().release(__s, bytes); });
+    }
+
+    template <typename T>
+    void basic_qubit<T>::detach() const
+    {
+        if (this->M_storage.use_count() <= 1)
+            return;
+        this->M_storage = basic_qubit::allocate_state(this->M_len, this->M_qubits);
+        this->M_qubits = this->M_storage.get();
     }
 
-    qubit::qubit(const std::size_t &n)
+    template <typename T>
+    basic_qubit<T>::basic_qubit(const std::size_t &n)
     {
         if (n < 1)
         {
@@ -164,135 +152,428 @@ namespace simulator
         }
         this->M_no_qubits = n;
         this->M_len = 1ULL << n;
-        this->M_qubits = new complex[this->M_len]();
+        this->M_storage = basic_qubit::allocate_state(this->M_len);
+        this->M_qubits = this->M_storage.get();
         this->M_qubits[0] = {1, 0}; // initial state |0> = 1 + 0i, 0 + 0i, 0 + 0i, ..., 0 + 0i
+        this->M_map.resize(n);
+        for (std::size_t q = 0; q < n; q++)
+            this->M_map[q] = q;
+        this->M_tile_qubits = 0;
+        this->M_batching = false;
+        this->M_seed = rng::get().fresh_seed();
+        this->M_draws = 0;
     }
 
-    qubit::qubit(const qubit &q)
+    template <typename T>
+    basic_qubit<T>::basic_qubit(const basic_qubit &q)
     {
+        q.flush();
+        this->M_map = q.M_map;
+        this->M_tile_qubits = 0;
+        this->M_batching = false;
+        this->M_seed = q.M_seed;
+        this->M_draws = q.M_draws;
         this->M_len = q.M_len;
         this->M_no_qubits = q.M_no_qubits;
-        this->M_qubits = new complex[this->M_len]();
-
-        for (std::size_t i = 0; i < this->M_len; i++)
-        {
-            this->M_qubits[i] = q.M_qubits[i];
-        }
+        // shared until either side writes
+        this->M_storage = q.M_storage;
+        this->M_qubits = q.M_qubits;
     }
 
-    qubit::qubit(qubit &&q) noexcept(true)
+    template <typename T>
+    basic_qubit<T>::basic_qubit(basic_qubit &&q) noexcept(true)
     {
         this->M_len = q.M_len;
         this->M_no_qubits = q.M_no_qubits;
         this->M_qubits = q.M_qubits;
+        this->M_storage = std::move(q.M_storage);
+        this->M_pending = std::move(q.M_pending);
+        this->M_map = std::move(q.M_map);
+        this->M_tile_qubits = q.M_tile_qubits;
+        this->M_batching = q.M_batching;
+        this->M_seed = q.M_seed;
+        this->M_draws = q.M_draws;
 
         q.M_len = q.M_no_qubits = 0;
         q.M_qubits = nullptr;
+        q.M_batching = false;
+    }
+
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::seed(const std::uint64_t &__seed)
+    {
+        this->M_seed = __seed;
+        this->M_draws = 0;
+        return *this;
+    }
+
+    template <typename T>
+    void basic_qubit<T>::run(const std::size_t &highest, deferred_gate &&__g)
+    {
+        if (this->M_batching && highest < this->M_tile_qubits)
+        {
+            this->M_pending.push_back(std::move(__g));
+            return;
+        }
+        this->flush();
+        this->detach();
+        __g(this->M_qubits, this->M_len);
+    }
+
+    template <typename T>
+    void basic_qubit<T>::flush() const
+    {
+        if (this->M_pending.empty())
+            return;
+
+        this->detach();
+        complex *s = this->M_qubits;
+        if (this->M_pending.size() == 1)
+            this->M_pending[0](s, this->M_len);
+        else
+        {
+            // every thread owns whole tiles, the kernels called from inside the pool run serially on their tile
+            const std::size_t tile = 1ULL << this->M_tile_qubits;
+            thread_pool::get().parallel_for(this->M_len, tile, [&](const std::size_t &b, const std::size_t &e)
+                                            {
+                for (std::size_t t = b; t < e; t += tile)
+                {
+                    for (const deferred_gate &g : this->M_pending)
+                    {
+                        complex *chunk = s + t;
+                        g(chunk, tile);
+                    }
+                } });
+        }
+        this->M_pending.clear();
+    }
+
+    template <typename T>
+    std::size_t basic_qubit<T>::physical(const std::size_t &q) const
+    {
+        if (q >= this->M_no_qubits)
+        {
+            std::fprintf(stderr, "error: qubit %zu is out of range for a %zu-qubit system.\n", q, this->M_no_qubits);
+            std::exit(EXIT_FAILURE);
+        }
+        return this->M_map[q];
+    }
+
+    template <typename T>
+    std::size_t basic_qubit<T>::physical_mask(const std::size_t &mask) const
+    {
+        std::size_t r = 0;
+        for (std::size_t m = mask; m; m &= m - 1)
+            r |= 1ULL << this->physical(std::countr_zero(m));
+        return r;
     }
 
-    qubit &qubit::apply_identity(const std::size_t &q_target)
+    template <typename T>
+    void basic_qubit<T>::materialize() const
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::IDENTITY, q_target);
+        this->flush();
+        // one physical SWAP per logical qubit out of place, each puts one more qubit on its own bit
+        for (std::size_t q = 0; q < this->M_no_qubits; q++)
+        {
+            if (this->M_map[q] == q)
+                continue;
+            this->detach();
+            complex *s = this->M_qubits;
+            const std::size_t other = std::find(this->M_map.begin(), this->M_map.end(), q) - this->M_map.begin();
+            basic_qubit::apply_2qubit_gate(s, this->M_len, gate_type::SWAP_GATE, this->M_map[q], q);
+            this->M_map[other] = this->M_map[q];
+            this->M_map[q] = q;
+        }
+    }
+
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::begin_batch()
+    {
+        // a vector that fits in one tile is cache resident anyway
+        // single-precision amplitudes are half the size, so a tile of the same bytes spans one more qubit
+        this->M_tile_qubits = kernels::tile_qubits() + (sizeof(T) < sizeof(double) ? 1 : 0);
+        this->M_batching = this->M_tile_qubits < this->M_no_qubits;
         return *this;
     }
 
-    qubit &qubit::apply_pauli_x(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::end_batch()
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::PAULI_X, q_target);
+        this->flush();
+        this->M_batching = false;
         return *this;
     }
 
-    qubit &qubit::apply_pauli_y(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_identity(const std::size_t &q_target)
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::PAULI_Y, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::IDENTITY, target); });
         return *this;
     }
 
-    qubit &qubit::apply_pauli_z(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_pauli_x(const std::size_t &q_target)
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::PAULI_Z, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::PAULI_X, target); });
         return *this;
     }
 
-    qubit &qubit::apply_hadamard(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_pauli_y(const std::size_t &q_target)
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::HADAMARD, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::PAULI_Y, target); });
         return *this;
     }
 
-    qubit &qubit::apply_phase_pi_2_shift(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_pauli_z(const std::size_t &q_target)
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::PHASE_PI_2_SHIFT, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::PAULI_Z, target); });
         return *this;
     }
 
-    qubit &qubit::apply_phase_pi_4_shift(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_hadamard(const std::size_t &q_target)
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::PHASE_PI_4_SHIFT, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::HADAMARD, target); });
         return *this;
     }
 
-    qubit &qubit::apply_phase_general_shift(const double &_theta, const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_phase_pi_2_shift(const std::size_t &q_target)
     {
-        qubit::apply_theta_gate(this->M_qubits, this->M_len, gate_type::PHASE_GENERAL_SHIFT, _theta, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::PHASE_PI_2_SHIFT, target); });
         return *this;
     }
 
-    qubit &qubit::apply_rotation_x(const double &_theta, const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_phase_pi_4_shift(const std::size_t &q_target)
     {
-        qubit::apply_theta_gate(this->M_qubits, this->M_len, gate_type::ROTATION_X, _theta, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::PHASE_PI_4_SHIFT, target); });
         return *this;
     }
 
-    qubit &qubit::apply_rotation_y(const double &_theta, const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_phase_general_shift(const double &_theta, const std::size_t &q_target)
     {
-        qubit::apply_theta_gate(this->M_qubits, this->M_len, gate_type::ROTATION_Y, _theta, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [_theta, target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_theta_gate(__s, _len, gate_type::PHASE_GENERAL_SHIFT, _theta, target); });
         return *this;
     }
 
-    qubit &qubit::apply_rotation_z(const double &_theta, const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_rotation_x(const double &_theta, const std::size_t &q_target)
     {
-        qubit::apply_theta_gate(this->M_qubits, this->M_len, gate_type::ROTATION_Z, _theta, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [_theta, target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_theta_gate(__s, _len, gate_type::ROTATION_X, _theta, target); });
         return *this;
     }
 
-    qubit &qubit::apply_v(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_rotation_y(const double &_theta, const std::size_t &q_target)
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::SQRT_OF_X_V, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [_theta, target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_theta_gate(__s, _len, gate_type::ROTATION_Y, _theta, target); });
         return *this;
     }
 
-    qubit &qubit::apply_adj_v(const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_rotation_z(const double &_theta, const std::size_t &q_target)
     {
-        qubit::apply_predefined_gate(this->M_qubits, this->M_len, gate_type::ADJ_SQRT_OF_X_V, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [_theta, target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_theta_gate(__s, _len, gate_type::ROTATION_Z, _theta, target); });
         return *this;
     }
 
-    qubit &qubit::apply_cnot(const std::size_t &q_control, const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_v(const std::size_t &q_target)
     {
-        qubit::apply_2qubit_gate(this->M_qubits, this->M_len, gate_type::CONTROLLED_NOT, q_control, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::SQRT_OF_X_V, target); });
         return *this;
     }
 
-    qubit &qubit::apply_cz(const std::size_t &q_control, const std::size_t &q_target)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_adj_v(const std::size_t &q_target)
     {
-        qubit::apply_2qubit_gate(this->M_qubits, this->M_len, gate_type::CONTROLLED_Z, q_control, q_target);
+        const std::size_t target = this->physical(q_target);
+        this->run(target, [target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_predefined_gate(__s, _len, gate_type::ADJ_SQRT_OF_X_V, target); });
         return *this;
     }
 
-    qubit &qubit::apply_swap(const std::size_t &qubit_1, const std::size_t &qubit_2)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_cnot(const std::size_t &q_control, const std::size_t &q_target)
     {
-        qubit::apply_2qubit_gate(this->M_qubits, this->M_len, gate_type::SWAP_GATE, qubit_1, qubit_2);
+        const std::size_t control = this->physical(q_control), target = this->physical(q_target);
+        this->run(std::max(control, target), [control, target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_2qubit_gate(__s, _len, gate_type::CONTROLLED_NOT, control, target); });
         return *this;
     }
 
-    void qubit::get_bloch_data(double (&__cord)[3], const std::size_t &nth) const
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_cz(const std::size_t &q_control, const std::size_t &q_target)
+    {
+        const std::size_t control = this->physical(q_control), target = this->physical(q_target);
+        this->run(std::max(control, target), [control, target](complex *&__s, const std::size_t &_len)
+                  { basic_qubit::apply_2qubit_gate(__s, _len, gate_type::CONTROLLED_Z, control, target); });
+        return *this;
+    }
+
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_swap(const std::size_t &qubit_1, const std::size_t &qubit_2)
+    {
+        // no amplitude moves: the two logical qubits trade their physical bits, `materialize` restores the order when needed
+        const std::size_t p1 = this->physical(qubit_1), p2 = this->physical(qubit_2);
+        basic_qubit::check_2qubit_gate(this->M_len, qubit_1, qubit_2);
+        this->M_map[qubit_1] = p2;
+        this->M_map[qubit_2] = p1;
+        return *this;
+    }
+
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_unitary(const gate_complex (&__m)[2][2], const std::size_t &q_target)
+    {
+        const complex m[2][2] = {{complex(__m[0][0]), complex(__m[0][1])}, {complex(__m[1][0]), complex(__m[1][1])}};
+        const std::size_t target = this->physical(q_target);
+        if (__m[0][1] == 0.0 && __m[1][0] == 0.0)
+            this->run(target, [m, target](complex *&__s, const std::size_t &_len)
+                      { kernels::apply_diagonal(__s, _len, m[0][0], m[1][1], target); });
+        else
+            this->run(target, [m, target](complex *&__s, const std::size_t &_len)
+                      { kernels::apply_2x2(__s, _len, m, target); });
+        return *this;
+    }
+
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_diagonal_run(const std::vector<std::size_t> &qubits, const std::vector<gate_complex> &phases)
+    {
+        if (phases.size() != (1ULL << qubits.size()))
+        {
+            std::fprintf(stderr, "error: phase table of a diagonal run over %zu qubits must have %zu entries, but it had %zu.\n", qubits.size(), (std::size_t)(1ULL << qubits.size()), phases.size());
+            std::exit(EXIT_FAILURE);
+        }
+        std::vector<std::size_t> targets(qubits.size());
+        for (std::size_t m = 0; m < qubits.size(); m++)
+            targets[m] = this->physical(qubits[m]);
+        const std::size_t highest = targets.empty() ? 0 : *std::max_element(targets.begin(), targets.end());
+        const std::vector<complex> table(phases.begin(), phases.end());
+        this->run(highest, [targets, table](complex *&__s, const std::size_t &_len)
+                  { kernels::apply_phase_table(__s, _len, targets, table); });
+        return *this;
+    }
+
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::apply_unitary(const std::vector<std::size_t> &qubits, const std::vector<gate_complex> &matrix)
+    {
+        if (qubits.empty() || qubits.size() > kernels::max_dense_qubits || matrix.size() != (1ULL << (2 * qubits.size())))
+        {
+            std::fprintf(stderr, "error: a dense block over %zu qubits is not supported (matrix had %zu entries).\n", qubits.size(), matrix.size());
+            std::exit(EXIT_FAILURE);
+        }
+        for (std::size_t i = 0; i < qubits.size(); i++)
+        {
+            for (std::size_t j = i + 1; j < qubits.size(); j++)
+            {
+                if (qubits[i] == qubits[j])
+                {
+                    std::fprintf(stderr, "error: qubit %zu appears twice in a dense block.\n", qubits[i]);
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            if (qubits[i] >= this->M_no_qubits)
+            {
+                std::fprintf(stderr, "error: qubit %zu is out of range for a %zu-qubit system.\n", qubits[i], this->M_no_qubits);
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        std::vector<std::size_t> targets(qubits.size());
+        for (std::size_t m = 0; m < qubits.size(); m++)
+            targets[m] = this->M_map[qubits[m]];
+        const std::vector<complex> block(matrix.begin(), matrix.end());
+        this->run(*std::max_element(targets.begin(), targets.end()), [targets, block](complex *&__s, const std::size_t &_len)
+                  { kernels::apply_dense(__s, _len, targets, block); });
+        return *this;
+    }
+
+    template <typename T>
+    typename basic_qubit<T>::snapshot basic_qubit<T>::take_snapshot() const
+    {
+        this->materialize();
+        snapshot snap;
+        snap.M_storage = this->M_storage;
+        snap.M_len = this->M_len;
+        snap.M_no_qubits = this->M_no_qubits;
+        return snap;
+    }
+
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::restore(const snapshot &__snap)
+    {
+        if (!__snap.M_storage)
+        {
+            std::fprintf(stderr, "error: cannot restore from an empty snapshot.\n");
+            std::exit(EXIT_FAILURE);
+        }
+        this->M_pending.clear();
+        this->M_storage = __snap.M_storage;
+        this->M_qubits = this->M_storage.get();
+        this->M_len = __snap.M_len;
+        this->M_no_qubits = __snap.M_no_qubits;
+        this->M_map.resize(this->M_no_qubits);
+        for (std::size_t q = 0; q < this->M_no_qubits; q++)
+            this->M_map[q] = q;
+        return *this;
+    }
+
+    template <typename T>
+    const typename basic_qubit<T>::complex *basic_qubit<T>::snapshot::get_qubits() const
+    {
+        return this->M_storage.get();
+    }
+
+    template <typename T>
+    const std::size_t &basic_qubit<T>::snapshot::get_size() const
+    {
+        return this->M_len;
+    }
+
+    template <typename T>
+    const std::size_t &basic_qubit<T>::snapshot::no_of_qubits() const
     {
+        return this->M_no_qubits;
+    }
+
+    template <typename T>
+    void basic_qubit<T>::get_bloch_data(double (&__cord)[3], const std::size_t &__nth) const
+    {
+        this->flush();
+        const std::size_t nth = this->physical(__nth);
         // __cord[0] = x
         // __cord[1] = y
         // __cord[2] = z
 
-        complex S = {0, 0};
+        // accumulated in double precision whatever the amplitude type
+        std::complex<double> S = {0, 0};
         double Z = 0;
 
         for (std::size_t i = 0; i < this->M_len; i++)
@@ -303,7 +584,7 @@ namespace simulator
 
             std::size_t j = i ^ (1ULL << nth);
 
-            qubit::complex a = this->M_qubits[i], b = this->M_qubits[j];
+            const std::complex<double> a = this->M_qubits[i], b = this->M_qubits[j];
 
             S += a * std::conj(b);
             Z += (std::norm(a) - std::norm(b));
@@ -314,28 +595,386 @@ namespace simulator
         __cord[2] = Z;
     }
 
-    const qubit::complex *qubit::get_qubits() const
+    template <typename T>
+    void basic_qubit<T>::get_bloch_data(std::vector<std::array<double, 3>> &__cords) const
+    {
+        this->flush();
+        const std::size_t n = this->M_no_qubits;
+        const std::size_t t = std::min(n, kernels::tile_qubits() + (sizeof(T) < sizeof(double) ? 1 : 0));
+        const std::size_t tile = 1ULL << t, ngroups = this->M_len >> t;
+        const complex *s = this->M_qubits;
+
+        // per tile-sized group: real and imaginary part of sum(a0 * conj(a1)) and sum(|a0|^2 - |a1|^2) of every physical qubit,
+        // the groups are summed pairwise at the end so the result does not depend on the thread count
+        std::vector<double> partial(ngroups * 3 * n, 0.0);
+        // sums over pairs (a_k, a_k + dist), a_k = a + k * step, into four interleaved accumulators so the additions do not wait
+        // on each other: acc[0] real and acc[1] imaginary part of a * conj(b), acc[2] |a|^2 - |b|^2
+        using sums = double[3][4];
+        auto mix = [](sums &__acc, const complex *__a, const std::size_t &dist, const std::size_t &count, const std::size_t &step, const bool &with_z)
+        {
+            // local copy, the amplitudes are doubles too and would otherwise force every sum through memory
+            double acc[3][4];
+            std::copy(&__acc[0][0], &__acc[0][0] + 12, &acc[0][0]);
+            const T *a = reinterpret_cast<const T *>(__a);
+            auto pair = [&](const std::size_t &k, const std::size_t &l)
+            {
+                const T *x = a + 2 * k * step, *y = x + 2 * dist;
+                acc[0][l] += double(x[0]) * y[0] + double(x[1]) * y[1];
+                acc[1][l] += double(x[1]) * y[0] - double(x[0]) * y[1];
+                if (with_z)
+                    acc[2][l] += (double(x[0]) * x[0] + double(x[1]) * x[1]) - (double(y[0]) * y[0] + double(y[1]) * y[1]);
+            };
+            std::size_t k = 0;
+            for (; k + 4 <= count; k += 4)
+            {
+                pair(k, 0);
+                pair(k + 1, 1);
+                pair(k + 2, 2);
+                pair(k + 3, 3);
+            }
+            for (; k < count; k++)
+                pair(k, 0);
+            std::copy(&acc[0][0], &acc[0][0] + 12, &__acc[0][0]);
+        };
+        auto total = [](const double (&v)[4])
+        { return (v[0] + v[1]) + (v[2] + v[3]); };
+
+        // qubits below t pair up inside a tile, the higher ones are constant over it and only need the tile's probability
+        thread_pool::get().parallel_for(this->M_len, tile, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            for (std::size_t g = b >> t; (g << t) < e; g++)
+            {
+                const complex *p = s + (g << t);
+                double *out = partial.data() + g * 3 * n;
+                for (std::size_t q = 0; q < t; q++)
+                {
+                    // short runs are walked column-wise instead, the tile is in cache either way
+                    const std::size_t stride = 1ULL << q;
+                    sums acc = {};
+                    if (stride < 4)
+                        for (std::size_t r = 0; r < stride; r++)
+                            mix(acc, p + r, stride, tile / (2 * stride), 2 * stride, true);
+                    else
+                        for (std::size_t base = 0; base < tile; base += 2 * stride)
+                            mix(acc, p + base, stride, stride, 1, true);
+                    out[3 * q] = total(acc[0]);
+                    out[3 * q + 1] = total(acc[1]);
+                    out[3 * q + 2] = total(acc[2]);
+                }
+                double prob[4] = {};
+                for (std::size_t j = 0; j < tile; j++)
+                    prob[j & 3] += std::norm(std::complex<double>(p[j]));
+                for (std::size_t q = t; q < n; q++)
+                    out[3 * q + 2] = ((g << t) >> q) & 1 ? -total(prob) : total(prob);
+            } });
+
+        // higher qubits [lo, lo + width): a group is 2^width slices of 2^(t - width) contiguous amplitudes, slice k starts at
+        // `base | k << lo`, so the whole group (2^t amplitudes) is read from memory once and stays in cache for all its qubits
+        // slices of at least 64 amplitudes keep the reads sequential enough for the prefetchers
+        const std::size_t h = t > 6 ? t - 6 : 1;
+        for (std::size_t lo = t; lo < n; lo += h)
+        {
+            const std::size_t width = std::min(h, n - lo), low_free = lo - (t - width);
+            const std::size_t slice = 1ULL << (t - width), slices = 1ULL << width;
+            thread_pool::get().parallel_for(this->M_len, tile, [&](const std::size_t &b, const std::size_t &e)
+                                            {
+                for (std::size_t g = b >> t; (g << t) < e; g++)
+                {
+                    const std::size_t base = ((g >> low_free) << (lo + width)) | ((g & ((1ULL << low_free) - 1)) << (t - width));
+                    double *out = partial.data() + g * 3 * n;
+                    for (std::size_t c = 0; c < width; c++)
+                    {
+                        sums acc = {};
+                        for (std::size_t k = 0; k < slices; k++)
+                            if (!((k >> c) & 1))
+                                mix(acc, s + (base | (k << lo)), 1ULL << (lo + c), slice, 1, false);
+                        out[3 * (lo + c)] = total(acc[0]);
+                        out[3 * (lo + c) + 1] = total(acc[1]);
+                    }
+                } });
+        }
+
+        for (std::size_t w = 1; w < ngroups; w <<= 1)
+            for (std::size_t g = 0; g + w < ngroups; g += w << 1)
+                for (std::size_t i = 0; i < 3 * n; i++)
+                    partial[g * 3 * n + i] += partial[(g + w) * 3 * n + i];
+
+        __cords.resize(n);
+        for (std::size_t q = 0; q < n; q++)
+        {
+            const double *r = partial.data() + 3 * this->M_map[q];
+            __cords[q] = {2.0 * r[0], 2.0 * r[1], r[2]};
+        }
+    }
+
+    template <typename T>
+    void basic_qubit<T>::get_pair_rdms(std::vector<std::array<std::complex<double>, 16>> &__rdms) const
+    {
+        this->flush();
+        const std::size_t n = this->M_no_qubits, npairs = n * (n - 1) / 2;
+        __rdms.assign(npairs, {});
+        if (n < 2)
+            return;
+        const std::size_t t = std::min(n, kernels::tile_qubits() + (sizeof(T) < sizeof(double) ? 1 : 0));
+        const std::size_t w = n <= t ? n : std::max<std::size_t>(t / 2, 1), nblocks = (n + w - 1) / w;
+        auto pair_index = [n](const std::size_t &a, const std::size_t &b)
+        { return a * (2 * n - a - 1) / 2 + (b - a - 1); };
+        auto insert_zero = [](const std::size_t &v, const std::size_t &bit)
+        { return ((v >> bit) << (bit + 1)) | (v & ((1ULL << bit) - 1)); };
+        const complex *s = this->M_qubits;
+
+        // sums per pair of physical qubits: 4 diagonal entries, then the 6 upper off-diagonal ones as real/imaginary parts
+        // a fixed number of slots, each summing a fixed run of groups in order, so the result does not depend on the thread count
+        static constexpr std::size_t slots = 64;
+        std::vector<double> partial(slots * npairs * 16, 0.0);
+
+        // sweep (i, j) keeps blocks i and j resident: it owns the pairs across them, and the pairs inside block j (inside
+        // blocks 0 and 1 for the first sweep), a single block holds every qubit when the whole vector fits in a tile
+        for (std::size_t bi = 0; bi < nblocks; bi++)
+            for (std::size_t bj = bi + 1; bj < nblocks || (nblocks == 1 && bj == 1); bj++)
+            {
+                const std::size_t s0 = bi * w, w0 = std::min(w, n - s0);
+                const std::size_t s1 = nblocks == 1 ? n : bj * w, w1 = nblocks == 1 ? 0 : std::min(w, n - s1);
+                const std::size_t resident = w0 + w1, group = 1ULL << resident, ngroups = this->M_len >> resident;
+
+                // resident qubits in local order, and the pairs of this sweep as (local a, local b, physical pair)
+                std::vector<std::size_t> local;
+                for (std::size_t q = 0; q < w0; q++)
+                    local.push_back(s0 + q);
+                for (std::size_t q = 0; q < w1; q++)
+                    local.push_back(s1 + q);
+                std::vector<std::array<std::size_t, 3>> owned;
+                for (std::size_t x = 0; x < resident; x++)
+                    for (std::size_t y = x + 1; y < resident; y++)
+                    {
+                        const bool in0 = y < w0, in1 = x >= w0;
+                        if (nblocks > 1 && ((in0 && !(bi == 0 && bj == 1)) || (in1 && bi != 0)))
+                            continue;
+                        owned.push_back({x, y, pair_index(local[x], local[y])});
+                    }
+                if (owned.empty())
+                    continue;
+
+                const std::size_t per_slot = std::max<std::size_t>(ngroups / slots, 1);
+                thread_pool::get().parallel_for(this->M_len, per_slot << resident, [&](const std::size_t &b, const std::size_t &e)
+                                                {
+                    std::vector<std::complex<double>> buf(group);
+                    for (std::size_t g = b >> resident; (g << resident) < e; g++)
+                    {
+                        // spread the group number over the qubits outside both blocks, then gather the group contiguously
+                        std::size_t base = 0, rest = g;
+                        for (std::size_t q = 0; q < n; q++)
+                            if (!((q >= s0 && q < s0 + w0) || (q >= s1 && q < s1 + w1)))
+                            {
+                                base |= (rest & 1) << q;
+                                rest >>= 1;
+                            }
+                        for (std::size_t hi = 0; hi < (1ULL << w1); hi++)
+                            for (std::size_t lo = 0; lo < (1ULL << w0); lo++)
+                                buf[(hi << w0) | lo] = s[base | (lo << s0) | (hi << s1)];
+
+                        double *slot = partial.data() + (g / per_slot) * npairs * 16;
+                        for (const auto &[x, y, pi] : owned)
+                        {
+                            const std::size_t bx = 1ULL << x, by = 1ULL << y;
+                            double acc[16] = {};
+                            auto outer = [&acc](const std::complex<double> &__r, const std::complex<double> &__c, const std::size_t &k)
+                            {
+                                acc[k] += __r.real() * __c.real() + __r.imag() * __c.imag();
+                                acc[k + 1] += __r.imag() * __c.real() - __r.real() * __c.imag();
+                            };
+                            for (std::size_t u = 0; u < (group >> 2); u++)
+                            {
+                                const std::size_t i = insert_zero(insert_zero(u, x), y);
+                                const std::complex<double> v0 = buf[i], v1 = buf[i | bx], v2 = buf[i | by], v3 = buf[i | bx | by];
+                                // not std::norm, which goes through a hypot call without -ffast-math
+                                acc[0] += v0.real() * v0.real() + v0.imag() * v0.imag();
+                                acc[1] += v1.real() * v1.real() + v1.imag() * v1.imag();
+                                acc[2] += v2.real() * v2.real() + v2.imag() * v2.imag();
+                                acc[3] += v3.real() * v3.real() + v3.imag() * v3.imag();
+                                outer(v0, v1, 4);
+                                outer(v0, v2, 6);
+                                outer(v0, v3, 8);
+                                outer(v1, v2, 10);
+                                outer(v1, v3, 12);
+                                outer(v2, v3, 14);
+                            }
+                            double *out = slot + pi * 16;
+                            for (std::size_t k = 0; k < 16; k++)
+                                out[k] += acc[k];
+                        }
+                    } });
+            }
+
+        for (std::size_t step = 1; step < slots; step <<= 1)
+            for (std::size_t k = 0; k + step < slots; k += step << 1)
+                for (std::size_t i = 0; i < npairs * 16; i++)
+                    partial[k * npairs * 16 + i] += partial[(k + step) * npairs * 16 + i];
+
+        // physical pair to logical pair, the basis index swaps its two bits when the mapping reverses the order
+        for (std::size_t a = 0; a < n; a++)
+            for (std::size_t b = a + 1; b < n; b++)
+            {
+                const std::size_t pa = this->M_map[a], pb = this->M_map[b];
+                const double *r = partial.data() + pair_index(std::min(pa, pb), std::max(pa, pb)) * 16;
+                std::array<std::complex<double>, 16> m;
+                std::size_t k = 4;
+                for (std::size_t i = 0; i < 4; i++)
+                {
+                    m[5 * i] = r[i];
+                    for (std::size_t j = i + 1; j < 4; j++, k += 2)
+                    {
+                        m[4 * i + j] = {r[k], r[k + 1]};
+                        m[4 * j + i] = {r[k], -r[k + 1]};
+                    }
+                }
+                if (pa > pb)
+                {
+                    static constexpr std::size_t swapped[4] = {0, 2, 1, 3};
+                    std::array<std::complex<double>, 16> p;
+                    for (std::size_t i = 0; i < 4; i++)
+                        for (std::size_t j = 0; j < 4; j++)
+                            p[4 * i + j] = m[4 * swapped[i] + swapped[j]];
+                    m = p;
+                }
+                __rdms[pair_index(a, b)] = m;
+            }
+    }
+
+    template <typename T>
+    void basic_qubit<T>::expectation(const std::vector<pauli_term> &__sum, std::vector<double> &__values) const
+    {
+        this->flush();
+        __values.assign(__sum.size(), 0.0);
+
+        // physical masks, terms grouped by X mask
+        std::map<std::size_t, std::vector<std::size_t>> groups;
+        std::vector<std::size_t> zmask(__sum.size());
+        for (std::size_t k = 0; k < __sum.size(); k++)
+        {
+            groups[this->physical_mask(__sum[k].M_x)].push_back(k);
+            zmask[k] = this->physical_mask(__sum[k].M_z);
+        }
+
+        static constexpr std::size_t slots = 64;
+        const complex *s = this->M_qubits;
+        for (const auto &[xmask, terms] : groups)
+        {
+            if (!xmask)
+            {
+                std::vector<std::size_t> masks(terms.size());
+                std::vector<double> values;
+                for (std::size_t t = 0; t < terms.size(); t++)
+                    masks[t] = zmask[terms[t]];
+                kernels::z_parities(s, this->M_len, masks, values);
+                for (std::size_t t = 0; t < terms.size(); t++)
+                    __values[terms[t]] = values[t];
+                continue;
+            }
+
+            // sum over the pairs (i, i ^ xmask) with the lowest bit of xmask clear: <P> = sign * sum (-1)^|i & z| * 2 Re or 2 Im
+            // of conj(a_(i ^ xmask)) * a_i, the real part when the number of Y is even, sign = i^#Y (times i when it is odd)
+            const std::size_t count = this->M_len / 2, low = std::countr_zero(xmask);
+            const std::size_t per_slot = std::max<std::size_t>(count / slots, 1);
+            std::vector<double> partial(slots * terms.size(), 0.0);
+            std::vector<unsigned char> imag(terms.size());
+            for (std::size_t t = 0; t < terms.size(); t++)
+                imag[t] = std::popcount(xmask & zmask[terms[t]]) & 1;
+
+            thread_pool::get().parallel_for(count, per_slot, [&](const std::size_t &b, const std::size_t &e)
+                                            {
+                for (std::size_t slot = b / per_slot; slot * per_slot < e; slot++)
+                {
+                    double *out = partial.data() + slot * terms.size();
+                    const std::size_t end = std::min(count, (slot + 1) * per_slot);
+                    for (std::size_t p = slot * per_slot; p < end; p++)
+                    {
+                        const std::size_t i = ((p >> low) << (low + 1)) | (p & ((1ULL << low) - 1));
+                        const std::complex<double> c = std::conj(std::complex<double>(s[i ^ xmask])) * std::complex<double>(s[i]);
+                        const double parts[2] = {2.0 * c.real(), 2.0 * c.imag()};
+                        for (std::size_t t = 0; t < terms.size(); t++)
+                            out[t] += std::popcount(i & zmask[terms[t]]) & 1 ? -parts[imag[t]] : parts[imag[t]];
+                    }
+                } });
+
+            for (std::size_t step = 1; step < slots; step <<= 1)
+                for (std::size_t k = 0; k + step < slots; k += step << 1)
+                    for (std::size_t t = 0; t < terms.size(); t++)
+                        partial[k * terms.size() + t] += partial[(k + step) * terms.size() + t];
+            for (std::size_t t = 0; t < terms.size(); t++)
+            {
+                const std::size_t ny = std::popcount(xmask & zmask[terms[t]]);
+                const double sign = ((ny + (ny & 1)) / 2) & 1 ? -1.0 : 1.0;
+                __values[terms[t]] = sign * partial[t];
+            }
+        }
+    }
+
+    template <typename T>
+    double basic_qubit<T>::expectation(const std::vector<pauli_term> &__sum) const
+    {
+        std::vector<double> values;
+        this->expectation(__sum, values);
+        double total = 0.0;
+        for (std::size_t k = 0; k < __sum.size(); k++)
+            total += __sum[k].M_coefficient * values[k];
+        return total;
+    }
+
+    template <typename T>
+    void basic_qubit<T>::z_expectation(const std::vector<std::size_t> &__masks, std::vector<double> &__values) const
+    {
+        this->flush();
+        std::vector<std::size_t> masks(__masks.size());
+        for (std::size_t k = 0; k < __masks.size(); k++)
+            masks[k] = this->physical_mask(__masks[k]);
+        kernels::z_parities(static_cast<const complex *>(this->M_qubits), this->M_len, masks, __values);
+    }
+
+    template <typename T>
+    double basic_qubit<T>::diagonal_cost(const std::vector<cost_term> &__cost) const
     {
+        this->flush();
+        std::vector<std::size_t> masks(__cost.size());
+        for (std::size_t k = 0; k < __cost.size(); k++)
+            masks[k] = this->physical_mask(__cost[k].M_mask);
+        std::vector<double> probs;
+        kernels::all_set_probabilities(static_cast<const complex *>(this->M_qubits), this->M_len, masks, probs);
+        double total = 0.0;
+        for (std::size_t k = 0; k < __cost.size(); k++)
+            total += __cost[k].M_weight * probs[k];
+        return total;
+    }
+
+    template <typename T>
+    const typename basic_qubit<T>::complex *basic_qubit<T>::get_qubits() const
+    {
+        this->materialize();
         return this->M_qubits;
     }
 
-    const std::size_t &qubit::get_size() const
+    template <typename T>
+    const std::size_t &basic_qubit<T>::get_size() const
     {
         return this->M_len;
     }
 
-    const std::size_t qubit::memory_consumption() const
+    template <typename T>
+    const std::size_t basic_qubit<T>::memory_consumption() const
     {
         return sizeof(complex) * (this->M_len);
     }
 
-    const std::size_t &qubit::no_of_qubits() const
+    template <typename T>
+    const std::size_t &basic_qubit<T>::no_of_qubits() const
     {
         return this->M_no_qubits;
     }
 
-    void qubit::get_nth_qubit(complex (&__s)[2], const std::size_t &nth) const
+    template <typename T>
+    void basic_qubit<T>::get_nth_qubit(complex (&__s)[2], const std::size_t &nth) const
     {
+        this->materialize();
         std::size_t mask = 1ULL << (this->M_no_qubits - nth - 1);
         for (std::size_t i = 0; i < this->M_len; i++)
         {
@@ -353,10 +992,12 @@ namespace simulator
         }
     }
 
-    double *&qubit::compute_probabilities(double *&probs) const
+    template <typename T>
+    double *&basic_qubit<T>::compute_probabilities(double *&probs) const
     {
         if (!probs)
             return probs;
+        this->materialize();
         for (std::size_t i = 0; i < this->M_len; i++)
         {
             probs[i] = std::norm(this->M_qubits[i]);
@@ -364,18 +1005,82 @@ namespace simulator
         return probs;
     }
 
-    std::size_t qubit::measure()
+    template <typename T>
+    void basic_qubit<T>::get_probabilities(double *__out, const std::size_t &first, const std::size_t &last) const
+    {
+        this->materialize();
+        const complex *s = this->M_qubits + first;
+        thread_pool::get().parallel_for(last - first, 1ULL << 12, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            for (std::size_t i = b; i < e; i++)
+                __out[i] = double(s[i].real()) * s[i].real() + double(s[i].imag()) * s[i].imag(); });
+    }
+
+    template <typename T>
+    void basic_qubit<T>::top_probabilities(std::vector<std::pair<std::size_t, double>> &__out, const std::size_t &k, const double &min_prob, const std::size_t &first, const std::size_t &last) const
+    {
+        __out.clear();
+        if (k == 0 || first >= last)
+            return;
+        this->materialize();
+
+        // `better(a, b)`: a ranks above b, so the front of each heap is its weakest entry
+        using entry = std::pair<std::size_t, double>;
+        auto better = [](const entry &a, const entry &b)
+        { return a.second > b.second || (a.second == b.second && a.first < b.first); };
+
+        // the selected set does not depend on how the range is split, fixed slots only keep the heap count bounded
+        static constexpr std::size_t slots = 64;
+        const std::size_t count = last - first, per_slot = (count + slots - 1) / slots;
+        std::vector<std::vector<entry>> heaps(slots);
+        const complex *s = this->M_qubits + first;
+        thread_pool::get().parallel_for(count, per_slot, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            for (std::size_t slot = b / per_slot; slot * per_slot < e; slot++)
+            {
+                std::vector<entry> &heap = heaps[slot];
+                heap.reserve(std::min(k, per_slot));
+                // indices only grow within a slot, so once the heap is full a tie with its weakest entry never displaces it
+                double floor = min_prob;
+                bool full = false;
+                const std::size_t end = std::min(count, (slot + 1) * per_slot);
+                for (std::size_t i = slot * per_slot; i < end; i++)
+                {
+                    const double p = double(s[i].real()) * s[i].real() + double(s[i].imag()) * s[i].imag();
+                    if (p < floor || (full && p == floor))
+                        continue;
+                    if (full)
+                    {
+                        std::pop_heap(heap.begin(), heap.end(), better);
+                        heap.back() = {first + i, p};
+                    }
+                    else
+                        heap.emplace_back(first + i, p);
+                    std::push_heap(heap.begin(), heap.end(), better);
+                    if ((full = heap.size() == k))
+                        floor = std::max(min_prob, heap.front().second);
+                }
+            } });
+
+        for (const std::vector<entry> &heap : heaps)
+            __out.insert(__out.end(), heap.begin(), heap.end());
+        const std::size_t keep = std::min(k, __out.size());
+        std::partial_sort(__out.begin(), __out.begin() + keep, __out.end(), better);
+        __out.resize(keep);
+    }
+
+    template <typename T>
+    std::size_t basic_qubit<T>::measure()
     {
+        this->flush();
+        this->detach();
         double tot_prob = 0.0;
         for (std::size_t i = 0; i < this->M_len; i++)
         {
             tot_prob += std::norm(this->M_qubits[i]);
         }
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution dist(0.0, tot_prob);
-        double r = dist(gen);
+        const double r = rng_stream(this->M_seed, this->M_draws++).uniform() * tot_prob;
 
         double accum = 0.0;
         std::size_t res = 0;
@@ -389,6 +1094,15 @@ namespace simulator
             }
         }
 
+        // the outcome is reported in logical order, the collapsed basis state needs no reordering, so the mapping resets
+        std::size_t logical = 0;
+        for (std::size_t q = 0; q < this->M_no_qubits; q++)
+        {
+            logical |= ((res >> this->M_map[q]) & 1) << q;
+            this->M_map[q] = q;
+        }
+        res = logical;
+
         for (std::size_t i = 0; i < this->M_len; i++)
         {
             this->M_qubits[i] = (i == res) ? (complex){1.0, 0.0} : (complex){0.0, 0.0};
@@ -397,97 +1111,293 @@ namespace simulator
         return res;
     }
 
-    std::size_t qubit::measure_nth_qubit(const std::size_t &nth)
+    template <typename T>
+    std::map<std::size_t, std::size_t> basic_qubit<T>::sample(const std::size_t &shots, const std::uint64_t &seed) const
     {
-        double prob0 = 0.0, prob1 = 0.0;
-
-        for (std::size_t i = 0; i < this->M_len; i++)
+        std::map<std::size_t, std::size_t> counts;
+        if (shots == 0)
+            return counts;
+        // read_options already rejects larger requests, this only guards other callers
+        if (shots > basic_qubit::max_shots)
         {
-            int bit = (i >> nth) & 1;
-            double ampSquared = std::norm(this->M_qubits[i]); // norm = |amplitude|^2
-            if (bit == 0)
-                prob0 += ampSquared;
-            else
-                prob1 += ampSquared;
+            std::fprintf(stderr, "error: at most %zu shots can be sampled, %zu were requested.\n", basic_qubit::max_shots, shots);
+            std::exit(EXIT_FAILURE);
         }
+        this->flush();
+
+        // running sums restart at every block, and the block totals are added afterwards: the blocks are fixed, so the table
+        // (and every draw) is the same whatever the number of threads
+        static constexpr std::size_t block = 1ULL << 12;
+        const std::size_t nblocks = (this->M_len + block - 1) / block;
+        const complex *s = this->M_qubits;
+        std::vector<double> cdf(this->M_len), offsets(nblocks);
+        thread_pool::get().parallel_for(this->M_len, block, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            for (std::size_t k = b / block; k * block < e; k++)
+            {
+                const std::size_t end = (k + 1) * block < this->M_len ? (k + 1) * block : this->M_len;
+                double acc = 0.0;
+                for (std::size_t i = k * block; i < end; i++)
+                {
+                    acc += std::norm(s[i]);
+                    cdf[i] = acc;
+                }
+                offsets[k] = acc;
+            } });
 
-        double totalProb = prob0 + prob1;
-        if (std::abs(totalProb - 1.0) > 1.0E-6)
+        double total = 0.0;
+        for (double &o : offsets)
         {
-            std::fprintf(stderr, "warning: state is not normalized, total probability = %lf\n", totalProb);
+            const double t = o;
+            o = total;
+            total += t;
         }
+        thread_pool::get().parallel_for(this->M_len, block, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            for (std::size_t i = b; i < e; i++)
+                cdf[i] += offsets[i / block]; });
+
+        // the shots are independent streams, drawn in parallel: a fixed number of slots each count a contiguous run of shots,
+        // so the memory follows the distinct outcomes rather than the shots, and the slots are added up at the end
+        static constexpr std::size_t slots = 64;
+        const std::size_t per_slot = (shots + slots - 1) / slots;
+        std::vector<std::map<std::size_t, std::size_t>> slot_counts(slots);
+        thread_pool::get().parallel_for(shots, per_slot, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            for (std::size_t shot = b; shot < e; shot++)
+            {
+                // first entry above the draw, zero-probability entries repeat the previous sum and are never picked
+                const double r = rng_stream(seed, rng::shot_streams + shot).uniform() * total;
+                std::size_t res = std::upper_bound(cdf.begin(), cdf.end(), r) - cdf.begin();
+                res = res < this->M_len ? res : this->M_len - 1;
+
+                std::size_t logical = 0;
+                for (std::size_t q = 0; q < this->M_no_qubits; q++)
+                    logical |= ((res >> this->M_map[q]) & 1) << q;
+                slot_counts[shot / per_slot][logical]++;
+            } });
+        for (const std::map<std::size_t, std::size_t> &slot : slot_counts)
+            for (const auto &[outcome, count] : slot)
+                counts[outcome] += count;
+        return counts;
+    }
 
-        // Randomly choose measurement outcome based on the computed probabilities.
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dis(0.0, 1.0);
-        double rnd = dis(gen);
+    template <typename T>
+    std::size_t basic_qubit<T>::measure_nth_qubit(const std::size_t &__nth)
+    {
+        this->physical(__nth); // range check before the shift
+        const std::size_t res = this->measure_qubits(1ULL << __nth);
+        return res == static_cast<std::size_t>(-1) ? res : res >> __nth;
+    }
 
-        int outcome = (rnd < prob0) ? 0 : 1;
+    template <typename T>
+    void basic_qubit<T>::joint_distribution(const std::size_t &pmask, std::vector<double> &__bins) const
+    {
+        // compressed index of the bits: the bits inside a block come from a table, the ones above it are fixed for the
+        // whole block
+        const std::size_t k = std::popcount(pmask), bins = 1ULL << k;
+        const std::size_t block = std::min(this->M_len, std::max<std::size_t>(1ULL << 12, bins << 4));
+        const std::size_t lb = std::countr_zero(block), nblocks = this->M_len / block;
+        const std::size_t low_mask = pmask & (block - 1), low_bits = std::popcount(low_mask);
+        auto compress = [](std::size_t x, std::size_t m)
+        {
+            std::size_t r = 0;
+            for (std::size_t bit = 0; m; m &= m - 1, bit++)
+                r |= ((x >> std::countr_zero(m)) & 1) << bit;
+            return r;
+        };
+        std::vector<std::size_t> low(low_mask ? block : 1, 0);
+        for (std::size_t j = 0; low_mask && j < block; j++)
+            low[j] = compress(j, low_mask);
+
+        // a fixed number of slots, each summing a contiguous range of blocks in order, so the scratch is slots * 2^k and the
+        // result does not depend on the thread count
+        static constexpr std::size_t slots = 64;
+        const std::size_t per_slot = (nblocks + slots - 1) / slots;
+        __bins.assign(slots * bins, 0.0);
+        const complex *s = this->M_qubits;
+        thread_pool::get().parallel_for(this->M_len, per_slot * block, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            for (std::size_t blk = b >> lb; (blk << lb) < e; blk++)
+            {
+                // four interleaved sums, so consecutive additions do not wait on each other
+                double acc[4][1ULL << basic_qubit::max_joint_qubits];
+                const std::size_t used = 1ULL << low_bits, wrap = low.size() - 1;
+                for (std::size_t l = 0; l < 4; l++)
+                    std::fill(acc[l], acc[l] + used, 0.0);
+                const T *p = reinterpret_cast<const T *>(s + (blk << lb));
+                auto sq = [p](const std::size_t &j)
+                { return double(p[2 * j]) * p[2 * j] + double(p[2 * j + 1]) * p[2 * j + 1]; };
+                std::size_t j = 0;
+                for (; j + 4 <= block; j += 4)
+                {
+                    acc[0][low[j & wrap]] += sq(j);
+                    acc[1][low[(j + 1) & wrap]] += sq(j + 1);
+                    acc[2][low[(j + 2) & wrap]] += sq(j + 2);
+                    acc[3][low[(j + 3) & wrap]] += sq(j + 3);
+                }
+                for (; j < block; j++)
+                    acc[0][low[j & wrap]] += sq(j);
+
+                double *out = __bins.data() + (blk / per_slot) * bins + (compress(blk << lb, pmask & ~(block - 1)) << low_bits);
+                for (std::size_t o = 0; o < used; o++)
+                    out[o] += (acc[0][o] + acc[1][o]) + (acc[2][o] + acc[3][o]);
+            } });
+
+        // pairwise over the slots, always in the same order
+        for (std::size_t w = 1; w < slots; w <<= 1)
+            for (std::size_t slot = 0; slot + w < slots; slot += w << 1)
+                for (std::size_t o = 0; o < bins; o++)
+                    __bins[slot * bins + o] += __bins[(slot + w) * bins + o];
+        __bins.resize(bins);
+    }
 
-        // Collapse the state vector: set amplitudes incompatible with the outcome to zero.
-        double normFactor = (outcome == 0) ? std::sqrt(prob0) : std::sqrt(prob1);
-        if (normFactor == 0)
+    template <typename T>
+    void basic_qubit<T>::marginal_probabilities(const std::size_t &mask, std::vector<double> &__hist) const
+    {
+        // read_options already rejects wider requests, this only guards other callers
+        if (std::popcount(mask) > static_cast<int>(basic_qubit::max_joint_qubits))
+        {
+            std::fprintf(stderr, "error: a marginal distribution spans at most %zu qubits, %d were requested.\n", basic_qubit::max_joint_qubits, std::popcount(mask));
+            std::exit(EXIT_FAILURE);
+        }
+        const std::size_t pmask = this->physical_mask(mask);
+        this->flush();
+        std::vector<double> bins;
+        this->joint_distribution(pmask, bins);
+
+        // `bins` is indexed by the physical bits in increasing order, the histogram by the logical ones
+        std::size_t rank[64] = {};
+        for (std::size_t m = pmask, bit = 0; m; m &= m - 1, bit++)
+            rank[std::countr_zero(m)] = bit;
+        std::vector<std::size_t> from;
+        for (std::size_t m = mask; m; m &= m - 1)
+            from.push_back(rank[this->M_map[std::countr_zero(m)]]);
+        __hist.assign(bins.size(), 0.0);
+        for (std::size_t o = 0; o < bins.size(); o++)
+        {
+            std::size_t j = 0;
+            for (std::size_t bit = 0; bit < from.size(); bit++)
+                j |= ((o >> from[bit]) & 1) << bit;
+            __hist[j] = bins[o];
+        }
+    }
+
+    template <typename T>
+    std::size_t basic_qubit<T>::measure_qubits(const std::size_t &mask)
+    {
+        std::size_t pmask = 0, rest = mask;
+        for (std::size_t q = 0, taken = 0; q < 64 && (rest >> q); q++)
+        {
+            if (!((rest >> q) & 1))
+                continue;
+            if (taken == basic_qubit::max_joint_qubits)
+                break;
+            pmask |= 1ULL << this->physical(q);
+            rest &= ~(1ULL << q);
+            taken++;
+        }
+        if (pmask == 0)
+            return 0;
+        this->flush();
+        this->detach();
+
+        std::vector<double> partial;
+        this->joint_distribution(pmask, partial);
+        const std::size_t bins = partial.size();
+
+        double total = 0.0;
+        for (std::size_t o = 0; o < bins; o++)
+            total += partial[o];
+        if (std::abs(total - 1.0) > 1.0E-6)
+        {
+            std::fprintf(stderr, "warning: state is not normalized, total probability = %lf\n", total);
+        }
+        if (total == 0.0)
         {
             std::fprintf(stderr, "error: measured probability is zero.");
             return -1;
         }
 
-        for (std::size_t i = 0; i < this->M_len; i++)
+        // first outcome whose running sum passes the draw, zero-probability outcomes are never picked
+        const double r = rng_stream(this->M_seed, this->M_draws++).uniform() * total;
+        std::size_t outcome = 0;
+        for (double acc = 0.0; outcome < bins; outcome++)
         {
-            int bit = (i >> nth) & 1;
-            if (bit != outcome)
-            {
-                this->M_qubits[i] = 0;
-            }
-            else
-            {
-                this->M_qubits[i] /= normFactor; // renormalize amplitude
-            }
+            acc += partial[outcome];
+            if (partial[outcome] > 0.0 && acc > r)
+                break;
         }
+        if (outcome == bins)
+            while (partial[--outcome] == 0.0)
+                ;
 
-        return outcome;
+        // back to physical bits, then to logical ones
+        std::size_t pout = 0, res = 0;
+        for (std::size_t m = pmask, bit = 0; m; m &= m - 1, bit++)
+            pout |= ((outcome >> bit) & 1) << std::countr_zero(m);
+        for (std::size_t q = 0; q < this->M_no_qubits; q++)
+            if (((mask >> q) & 1) && ((pmask >> this->M_map[q]) & 1))
+                res |= ((pout >> this->M_map[q]) & 1) << q;
+
+        kernels::apply_projector(this->M_qubits, this->M_len, pmask, pout, complex(1.0 / std::sqrt(partial[outcome]), 0.0));
+
+        if (rest)
+        {
+            const std::size_t more = this->measure_qubits(rest);
+            return more == static_cast<std::size_t>(-1) ? more : res | more;
+        }
+        return res;
     }
 
-    qubit &qubit::operator=(const qubit &q)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::operator=(const basic_qubit &q)
     {
         if (this != &q)
         {
-            if (this->M_qubits)
-                delete[] this->M_qubits;
-
+            q.flush();
+            this->M_pending.clear();
+            this->M_map = q.M_map;
+            this->M_batching = false;
+            this->M_seed = q.M_seed;
+            this->M_draws = q.M_draws;
             this->M_len = q.M_len;
             this->M_no_qubits = q.M_no_qubits;
-            this->M_qubits = new complex[this->M_len]();
-
-            for (std::size_t i = 0; i < this->M_len; i++)
-            {
-                this->M_qubits[i] = q.M_qubits[i];
-            }
+            this->M_storage = q.M_storage;
+            this->M_qubits = q.M_qubits;
         }
         return *this;
     }
 
-    qubit &qubit::operator=(qubit &&q) noexcept(true)
+    template <typename T>
+    basic_qubit<T> &basic_qubit<T>::operator=(basic_qubit &&q) noexcept(true)
     {
         if (this != &q)
         {
-            if (this->M_qubits)
-                delete[] this->M_qubits;
-
             this->M_len = q.M_len;
             this->M_no_qubits = q.M_no_qubits;
             this->M_qubits = q.M_qubits;
+            this->M_storage = std::move(q.M_storage);
+            this->M_pending = std::move(q.M_pending);
+            this->M_map = std::move(q.M_map);
+            this->M_tile_qubits = q.M_tile_qubits;
+            this->M_batching = q.M_batching;
+            this->M_seed = q.M_seed;
+            this->M_draws = q.M_draws;
 
             q.M_len = q.M_no_qubits = 0;
             q.M_qubits = nullptr;
+            q.M_batching = false;
         }
         return *this;
     }
 
-    qubit::~qubit()
+    template <typename T>
+    basic_qubit<T>::~basic_qubit()
     {
-        if (this->M_qubits)
-            delete[] this->M_qubits;
+        // `M_storage` hands the amplitudes back to the pool once its last owner is gone
     }
-}
\ No newline at end of file
+
+    template class basic_qubit<double>;
+    template class basic_qubit<float>;
+}
@@ -8,15 +8,42 @@
 #define SIMULATOR_GATES
 
 #include <complex>
-#include <random>
+#include <vector>
+#include <array>
+#include <map>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <cmath> // for sqrt and M_PI
+#include "../random/rng.hh"
 
 namespace simulator
 {
-    class qubit
+    // coefficient * (P_0 x P_1 x ...), bit q of `M_x` is set where P_q is X or Y and bit q of `M_z` where P_q is Z or Y
+    // (q logical, a Y is both bits), so the term maps |i> to i^#Y * (-1)^|i & M_z| * |i ^ M_x>
+    struct pauli_term
+    {
+        double M_coefficient = 1.0;
+        std::size_t M_x = 0, M_z = 0;
+    };
+
+    // weight * x_q0 * x_q1 * ... over the bits of a basis state (bit q of `M_mask` set for each logical qubit q in the product),
+    // a diagonal cost function such as a MaxCut or QUBO objective is a sum of these, an empty mask is a constant
+    struct cost_term
+    {
+        double M_weight = 1.0;
+        std::size_t M_mask = 0;
+    };
+
+    // a state-vector simulator over amplitudes of type `std::complex<T>`, instantiated for double (`qubit`) and for float
+    // (`qubit_f`, half the memory and twice the amplitudes per SIMD register, at ~1e-7 relative precision)
+    // gate matrices always arrive in double precision and are rounded once, when the gate is applied
+    template <typename T>
+    class basic_qubit
     {
       public:
-        using complex = std::complex<double>;
+        using complex = std::complex<T>;
+        using gate_complex = std::complex<double>;
 
       private:
         enum gate_type : unsigned char
@@ -42,7 +69,7 @@ namespace simulator
         struct qgate_2x2
         {
             gate_type type;
-            complex matrix[2][2]; // 2x2 matrix that stores various types of gates
+            gate_complex matrix[2][2]; // 2x2 matrix that stores various types of gates
         };
 
         static constexpr qgate_2x2 pre_defined_qgates[9] = {
@@ -53,55 +80,169 @@ namespace simulator
             {HADAMARD, {{M_SQRT1_2, M_SQRT1_2}, {M_SQRT1_2, -M_SQRT1_2}}},
             {PHASE_PI_2_SHIFT, {{1, 0}, {0, {0, 1}}}},                 // e^(i * pi/2) = i
             {PHASE_PI_4_SHIFT, {{1, 0}, {0, {M_SQRT1_2, M_SQRT1_2}}}}, // e^(i * pi/4) = (sqrt(2)/2) + i(sqrt(2)/2)
-            {SQRT_OF_X_V, {{(complex){0.5, 0.5}, (complex){0.5, -0.5}}, {(complex){0.5, -0.5}, (complex){0.5, 0.5}}}},
-            {ADJ_SQRT_OF_X_V, {{(complex){0.5, -0.5}, (complex){0.5, 0.5}}, {(complex){0.5, 0.5}, (complex){0.5, -0.5}}}}};
+            {SQRT_OF_X_V, {{(gate_complex){0.5, 0.5}, (gate_complex){0.5, -0.5}}, {(gate_complex){0.5, -0.5}, (gate_complex){0.5, 0.5}}}},
+            {ADJ_SQRT_OF_X_V, {{(gate_complex){0.5, -0.5}, (gate_complex){0.5, 0.5}}, {(gate_complex){0.5, 0.5}, (gate_complex){0.5, -0.5}}}}};
 
+        // rounds a double-precision 2x2 gate to the amplitude type, diagonal matrices take the diagonal kernel
+        static void apply_matrix(complex *&__s, const std::size_t &_len, const gate_complex (&__m)[2][2], const std::size_t &qubit_target);
         static void apply_predefined_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const std::size_t &qubit_target);
         static qgate_2x2 &get_theta_gate(qgate_2x2 &__g, const gate_type &__g_type, const double &__theta);
         static void apply_theta_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const double &__theta, const std::size_t &qubit_target);
+        static void check_2qubit_gate(const std::size_t &_len, const std::size_t &q_control, const std::size_t &q_target);
         static void apply_2qubit_gate(complex *&__s, const std::size_t &_len, const gate_type &__g_type, const std::size_t &q_control, const std::size_t &q_target);
 
         // a vector-space (hilbert-space) defined over complex numbers C
         // 1 << M_no_qubits translates to 2^N, where N is the number of qubit the hilbert-space(quantum-system) supports
-        // memory consumption on x86_64 architecture for N-qubit system is: f(N) = 16 * 2^abs(N) bytes, that is exponential growth
+        // memory consumption on x86_64 architecture for N-qubit system is: f(N) = 2 * sizeof(T) * 2^abs(N) bytes (16 or 8), that is exponential growth
         // Initially, the hilbert-space is defined as 1 + 0i, 0 + 0i, 0 + 0i, 0 + 0i, 0 + 0i, ..., 0 + 0i
-        complex *M_qubits;
+        // copies and snapshots share `M_storage` until one of them writes, `M_qubits` is always `M_storage.get()`
+        // both are mutable because a const reader that has to apply pending gates first takes its own copy if shared
+        mutable complex *M_qubits;
+        mutable std::shared_ptr<complex> M_storage;
         std::size_t M_len, M_no_qubits;
 
+        // a gate recorded while batching, it can be applied to the whole vector or to any aligned tile of it
+        using deferred_gate = std::function<void(complex *&, const std::size_t &)>;
+        // gates queued by `begin_batch`, they are applied tile by tile (2^M_tile_qubits amplitudes) before the state is read
+        // or a gate on a higher qubit arrives, mutable because reading the state from a const method applies them first
+        mutable std::vector<deferred_gate> M_pending;
+        // logical-to-physical qubit mapping: logical qubit q lives on bit `M_map[q]` of the amplitude index, SWAP only
+        // relabels, mutable because emitting the raw amplitudes from a const method first restores the canonical order
+        mutable std::vector<std::size_t> M_map;
+        std::size_t M_tile_qubits;
+        bool M_batching;
+        // every collapse draws from its own `rng_stream` (M_seed, M_draws++), so a seeded run measures the same way every time
+        std::uint64_t M_seed, M_draws;
+
+        // huge-page backed storage first touched by the threads that will sweep it, see `allocator`, zero-filled or a parallel
+        // copy of `__src`, it goes back to `buffer_pool` with its last owner
+        static std::shared_ptr<complex> allocate_state(const std::size_t &_len, const complex *__src = nullptr);
+        // called before every write of the amplitudes: takes a private copy if the storage is shared
+        void detach() const;
+
+        void run(const std::size_t &highest, deferred_gate &&__g);
+        void flush() const;
+        std::size_t physical(const std::size_t &q) const;
+        // `mask` of logical qubits as a mask of amplitude-index bits
+        std::size_t physical_mask(const std::size_t &mask) const;
+        // probabilities of the 2^popcount(pmask) values of the amplitude-index bits in `pmask` (at most max_joint_qubits, bit j
+        // of a bin is the j-th lowest bit of pmask) in one parallel pass: 64 fixed slots each sum a contiguous range of blocks
+        // into their own 2^k bins, then the slots are summed pairwise, the caller flushes first
+        void joint_distribution(const std::size_t &pmask, std::vector<double> &__bins) const;
+
       public:
-        qubit() = delete;
-        qubit(const std::size_t &n);
-        qubit(const qubit &q);
-        qubit(qubit &&q) noexcept(true);
-        qubit &apply_identity(const std::size_t &q_target);
-        qubit &apply_pauli_x(const std::size_t &q_target);
-        qubit &apply_pauli_y(const std::size_t &q_target);
-        qubit &apply_pauli_z(const std::size_t &q_target);
-        qubit &apply_hadamard(const std::size_t &q_target);
-        qubit &apply_phase_pi_2_shift(const std::size_t &q_target);
-        qubit &apply_phase_pi_4_shift(const std::size_t &q_target);
-        qubit &apply_phase_general_shift(const double &_theta, const std::size_t &q_target);
-        qubit &apply_rotation_x(const double &_theta, const std::size_t &q_target);
-        qubit &apply_rotation_y(const double &_theta, const std::size_t &q_target);
-        qubit &apply_rotation_z(const double &_theta, const std::size_t &q_target);
-        qubit &apply_v(const std::size_t &q_target);
-        qubit &apply_adj_v(const std::size_t &q_target);
-        qubit &apply_cnot(const std::size_t &q_control, const std::size_t &q_target);
-        qubit &apply_cz(const std::size_t &q_control, const std::size_t &q_target);
-        qubit &apply_swap(const std::size_t &qubit_1, const std::size_t &qubit_2);
+        // widest group `measure_qubits` collapses in one go and widest `marginal_probabilities`, the joint distribution has 2^N
+        // bins per slot
+        static constexpr std::size_t max_joint_qubits = 10;
+        // most shots `sample` draws in one call, every shot is a binary search over the whole state
+        static constexpr std::size_t max_shots = 1ULL << 20;
+
+        // the state at the time it was taken, read-only, it costs no copy until the qubit it came from is written to
+        class snapshot
+        {
+            friend class basic_qubit;
+            std::shared_ptr<complex> M_storage;
+            std::size_t M_len = 0, M_no_qubits = 0;
+
+          public:
+            [[nodiscard]] const complex *get_qubits() const;
+            [[nodiscard]] const std::size_t &get_size() const;
+            [[nodiscard]] const std::size_t &no_of_qubits() const;
+        };
+
+        basic_qubit() = delete;
+        basic_qubit(const std::size_t &n);
+        basic_qubit(const basic_qubit &q);
+        basic_qubit(basic_qubit &&q) noexcept(true);
+        basic_qubit &apply_identity(const std::size_t &q_target);
+        basic_qubit &apply_pauli_x(const std::size_t &q_target);
+        basic_qubit &apply_pauli_y(const std::size_t &q_target);
+        basic_qubit &apply_pauli_z(const std::size_t &q_target);
+        basic_qubit &apply_hadamard(const std::size_t &q_target);
+        basic_qubit &apply_phase_pi_2_shift(const std::size_t &q_target);
+        basic_qubit &apply_phase_pi_4_shift(const std::size_t &q_target);
+        basic_qubit &apply_phase_general_shift(const double &_theta, const std::size_t &q_target);
+        basic_qubit &apply_rotation_x(const double &_theta, const std::size_t &q_target);
+        basic_qubit &apply_rotation_y(const double &_theta, const std::size_t &q_target);
+        basic_qubit &apply_rotation_z(const double &_theta, const std::size_t &q_target);
+        basic_qubit &apply_v(const std::size_t &q_target);
+        basic_qubit &apply_adj_v(const std::size_t &q_target);
+        basic_qubit &apply_cnot(const std::size_t &q_control, const std::size_t &q_target);
+        basic_qubit &apply_cz(const std::size_t &q_control, const std::size_t &q_target);
+        basic_qubit &apply_swap(const std::size_t &qubit_1, const std::size_t &qubit_2);
+        // applies an arbitrary 2x2 unitary (e.g. a fused chain of gates), diagonal matrices take the diagonal kernel
+        basic_qubit &apply_unitary(const gate_complex (&__m)[2][2], const std::size_t &q_target);
+        // applies a merged run of diagonal gates in a single sweep, see kernels::apply_phase_table for the table layout
+        basic_qubit &apply_diagonal_run(const std::vector<std::size_t> &qubits, const std::vector<gate_complex> &phases);
+        // applies a dense 2^N x 2^N unitary over up to 5 distinct qubits in one sweep, see kernels::apply_dense for the layout
+        basic_qubit &apply_unitary(const std::vector<std::size_t> &qubits, const std::vector<gate_complex> &matrix);
+        // between these calls, consecutive gates that only touch qubits below `kernels::tile_qubits()` are not streamed through
+        // the whole vector one by one: each L2-sized tile goes through the whole run while it is cache resident
+        // a gate on a higher qubit, a measurement or any read of the state applies the queued gates first
+        basic_qubit &begin_batch();
+        basic_qubit &end_batch();
+        // restarts the measurement streams from `__seed`, a fresh seed from `rng` is used otherwise
+        basic_qubit &seed(const std::uint64_t &__seed);
+        // physically reorders the amplitudes so that logical qubit q is bit q again (called by every raw-amplitude reader)
+        void materialize() const;
+        // copy-on-write checkpoints: `restore` shares the snapshot's amplitudes again, pending gates and the qubit mapping
+        // are applied before a snapshot is taken
+        [[nodiscard]] snapshot take_snapshot() const;
+        basic_qubit &restore(const snapshot &__snap);
         void get_bloch_data(double (&__cord)[3], const std::size_t &nth) const;
+        // bloch vectors of every qubit (logical order) from cache-resident tiles instead of one sweep per qubit: the first
+        // sweep gives every z and the x, y of the qubits inside a tile, each further sweep covers the next tile-width group of
+        // higher qubits
+        void get_bloch_data(std::vector<std::array<double, 3>> &__cords) const;
+        // 4x4 reduced density matrices of every pair of qubits a < b (logical), in the order (0, 1), (0, 2), ..., (n - 2, n - 1),
+        // row-major, row/column index = bit of a | bit of b << 1: the qubits are split into blocks of half a tile and each
+        // sweep gathers cache-sized groups spanning two blocks, so every pair is accumulated from cache in one of them
+        void get_pair_rdms(std::vector<std::array<std::complex<double>, 16>> &__rdms) const;
+        // <P_k> of every term (coefficients not applied) without touching the state: terms with the same X/Y mask read the
+        // same amplitude pairs (i, i ^ mask) and share one parallel sweep, each adds the product with its own Z parity sign
+        void expectation(const std::vector<pauli_term> &__sum, std::vector<double> &__values) const;
+        // sum of coefficient * <P_k>
+        [[nodiscard]] double expectation(const std::vector<pauli_term> &__sum) const;
+        // <Z_m> = sum |a_i|^2 * (-1)^popcount(i & m) of every logical mask m, computed from the amplitudes in one pass
+        // (`kernels::z_parities`), diagonal terms of `expectation` go through it as well
+        void z_expectation(const std::vector<std::size_t> &__masks, std::vector<double> &__values) const;
+        // expected value of a diagonal cost polynomial over the measured bitstring, sum of weight * P(every bit of the mask is 1)
+        // in one pass (`kernels::all_set_probabilities`)
+        [[nodiscard]] double diagonal_cost(const std::vector<cost_term> &__cost) const;
         const complex *get_qubits() const;
         const std::size_t &get_size() const;
         const std::size_t memory_consumption() const;
         const std::size_t &no_of_qubits() const;
         void get_nth_qubit(complex (&__s)[2], const std::size_t &nth) const;
         double *&compute_probabilities(double *&probs) const;
+        // probabilities of the basis states [first, last) (logical order) into `__out`, so a caller can stream the distribution
+        // window by window instead of holding all 2^n of it
+        void get_probabilities(double *__out, const std::size_t &first, const std::size_t &last) const;
+        // the `k` most likely basis states in [first, last) whose probability is at least `min_prob`, as (index, probability)
+        // sorted by decreasing probability then index: one parallel pass keeps a k-entry heap per slot, and only the heaps are
+        // merged, the probability array is never built
+        void top_probabilities(std::vector<std::pair<std::size_t, double>> &__out, const std::size_t &k, const double &min_prob, const std::size_t &first, const std::size_t &last) const;
         std::size_t measure();
+        // draws `shots` outcomes (indices in logical qubit order) without collapsing the state and returns how often each one
+        // came up: the cumulative distribution is built once, in parallel, and every draw is a binary search over it
+        // shot k draws from stream `rng::shot_streams + k` of `seed`, so the same seed gives the same counts on any number of threads
+        [[nodiscard]] std::map<std::size_t, std::size_t> sample(const std::size_t &shots, const std::uint64_t &seed) const;
         std::size_t measure_nth_qubit(const std::size_t &nth);
-        qubit &operator=(const qubit &q);
-        qubit &operator=(qubit &&q) noexcept(true);
-        ~qubit();
+        // measures every qubit set in `mask` (bit q is logical qubit q) at once and returns their outcomes at the same bits:
+        // one parallel pass collects the joint distribution, a second one clears the rejected amplitudes and renormalises the
+        // kept ones, more than `max_joint_qubits` qubits are measured `max_joint_qubits` at a time
+        std::size_t measure_qubits(const std::size_t &mask);
+        // probabilities of the 2^k outcomes of the k <= max_joint_qubits qubits in `mask` (bit q is logical qubit q), bit j of
+        // an outcome is the j-th lowest qubit of the mask: one parallel pass over the state with slot-local bins, the bits are
+        // gathered pext-style from a per-block table, so the result is 2^k values instead of 2^n
+        void marginal_probabilities(const std::size_t &mask, std::vector<double> &__hist) const;
+        basic_qubit &operator=(const basic_qubit &q);
+        basic_qubit &operator=(basic_qubit &&q) noexcept(true);
+        ~basic_qubit();
     };
+
+    using qubit = basic_qubit<double>;
+    using qubit_f = basic_qubit<float>;
 }
 
 #endif
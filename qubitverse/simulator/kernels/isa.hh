@@ -0,0 +1,177 @@
+/**
+ * @file isa.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_KERNELS_ISA
+#define SIMULATOR_KERNELS_ISA
+
+#include "./kernels.hh"
+
+// every ISA variant lives in its own translation unit and is compiled with function-level target attributes,
+// so the binary itself is built for the baseline architecture and never executes an instruction the CPU lacks
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define SIMULATOR_KERNELS_X86 1
+#endif
+
+#if defined(__GNUC__)
+#define SIMULATOR_TARGET(__isa) __attribute__((target(__isa)))
+#else
+#define SIMULATOR_TARGET(__isa)
+#endif
+
+namespace simulator
+{
+    namespace kernels
+    {
+        // every variant works on a range [_begin, _end) of amplitude pairs, so that the pairs can be split across the thread pool
+        // pair `p` is made of the amplitudes `pair_base(p, stride)` and `pair_base(p, stride) + stride`, where `stride` is 2^q_target
+        // every signature is templated on the scalar type `T` of the amplitudes (double, or float in single-precision mode)
+        template <typename T>
+        using fn_2x2 = void (*)(std::complex<T> *__s, const std::complex<T> (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+
+        // multiplies `count` contiguous amplitudes by `c`
+        template <typename T>
+        using fn_scale = void (*)(std::complex<T> *__p, const std::size_t &count, const std::complex<T> &c);
+        // multiplies `count` contiguous amplitudes by a pattern of period 8 (`__c` holds 8 entries): amplitude j by `__c[j & 7]`,
+        // `__p` sits at an index that is a multiple of 8, so the pattern carries the phases of qubits 0-2 in fixed lanes
+        template <typename T>
+        using fn_scale_periodic = void (*)(std::complex<T> *__p, const std::size_t &count, const std::complex<T> *__c);
+        // diagonal single-qubit gate diag(d0, d1) over pairs [_begin, _end), the |0> half is left untouched when d0 == 1
+        template <typename T>
+        using fn_diagonal = void (*)(std::complex<T> *__s, const std::complex<T> &d0, const std::complex<T> &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+
+        // X on pairs [_begin, _end): exchanges the |0> and |1> amplitude of every pair, a pure memory move
+        template <typename T>
+        using fn_swap_pairs = void (*)(std::complex<T> *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+
+        // a dense block over `M_count` qubits, `M_strides` holds their 2^qubit values sorted ascending, `M_offsets[r]` is the index
+        // offset of the block's local basis state `r` (bit j of r is the j-th qubit of the block, in the matrix's own order)
+        template <typename T>
+        struct dense_plan
+        {
+            std::size_t M_count, M_dim;
+            std::size_t M_strides[max_dense_qubits];
+            std::size_t M_offsets[1ULL << max_dense_qubits];
+            const std::complex<T> *M_matrix; // row-major, M_dim x M_dim
+        };
+
+        // applies the block to groups [_begin, _end), group `k` is the amplitudes `dense_base(k) + M_offsets[r]`
+        template <typename T>
+        using fn_dense = void (*)(std::complex<T> *__s, const dense_plan<T> &__p, const std::size_t &_begin, const std::size_t &_end);
+
+        // a pass whose two halves are a page or more apart (a high target qubit) reads two distant streams, which the hardware
+        // prefetchers follow poorly across page boundaries, so the SIMD loops prefetch both streams `prefetch_ahead` bytes ahead
+        template <typename T>
+        constexpr std::size_t prefetch_min_stride = 4096 / sizeof(std::complex<T>);
+        static constexpr std::size_t prefetch_ahead = 512;
+
+        // inserts a 0 bit at the target position of `p`
+        inline std::size_t pair_base(const std::size_t &p, const std::size_t &stride)
+        {
+            return ((p & ~(stride - 1)) << 1) | (p & (stride - 1));
+        }
+
+        // number of pairs starting from `p` whose |0> amplitudes are contiguous in memory, clipped to `_end`
+        inline std::size_t pair_run(const std::size_t &p, const std::size_t &stride, const std::size_t &_end)
+        {
+            const std::size_t run = stride - (p & (stride - 1));
+            return run < _end - p ? run : _end - p;
+        }
+
+        // two-qubit gates enumerate quarters: quarter `k` is the index `quarter_base(k, lo, hi)` with both qubit bits cleared,
+        // `lo`/`hi` being 2^(lower qubit) and 2^(higher qubit)
+        inline std::size_t quarter_base(const std::size_t &k, const std::size_t &lo, const std::size_t &hi)
+        {
+            return pair_base(pair_base(k, lo), hi);
+        }
+
+        // inserts a 0 bit at every qubit position of the block
+        template <typename T>
+        inline std::size_t dense_base(const std::size_t &k, const dense_plan<T> &__p)
+        {
+            std::size_t b = k;
+            for (std::size_t j = 0; j < __p.M_count; j++)
+                b = pair_base(b, __p.M_strides[j]);
+            return b;
+        }
+
+        // the scalar kernels are templates, instantiated for double and float in kernels_scalar.cc
+        namespace scalar
+        {
+            template <typename T>
+            void apply_2x2(std::complex<T> *__s, const std::complex<T> (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            template <typename T>
+            void scale(std::complex<T> *__p, const std::size_t &count, const std::complex<T> &c);
+            template <typename T>
+            void scale_periodic(std::complex<T> *__p, const std::size_t &count, const std::complex<T> *__c);
+            template <typename T>
+            void apply_diagonal(std::complex<T> *__s, const std::complex<T> &d0, const std::complex<T> &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            template <typename T>
+            void swap_pairs(std::complex<T> *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            template <typename T>
+            void apply_dense(std::complex<T> *__s, const dense_plan<T> &__p, const std::size_t &_begin, const std::size_t &_end);
+
+            // the quarter kernels only touch the affected quarter(s) of the vector-space, over quarters [_begin, _end)
+            template <typename T>
+            void apply_cnot(std::complex<T> *__s, const std::size_t &control, const std::size_t &target, const std::size_t &_begin, const std::size_t &_end);
+            template <typename T>
+            void apply_cz(std::complex<T> *__s, const std::size_t &control, const std::size_t &target, const std::size_t &_begin, const std::size_t &_end);
+            template <typename T>
+            void apply_swap(std::complex<T> *__s, const std::size_t &q1, const std::size_t &q2, const std::size_t &_begin, const std::size_t &_end);
+        }
+
+#if defined(SIMULATOR_KERNELS_X86)
+        namespace sse42
+        {
+            void apply_2x2(complex *__s, const complex (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void scale(complex *__p, const std::size_t &count, const complex &c);
+            void scale_periodic(complex *__p, const std::size_t &count, const complex *__c);
+            void apply_diagonal(complex *__s, const complex &d0, const complex &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void swap_pairs(complex *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void apply_dense(complex *__s, const dense_plan<double> &__p, const std::size_t &_begin, const std::size_t &_end);
+
+            // single precision: twice the amplitudes per register, permutations and dense blocks use the scalar templates
+            void apply_2x2(complex_f *__s, const complex_f (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void scale(complex_f *__p, const std::size_t &count, const complex_f &c);
+            void scale_periodic(complex_f *__p, const std::size_t &count, const complex_f *__c);
+            void apply_diagonal(complex_f *__s, const complex_f &d0, const complex_f &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+        }
+
+        namespace avx2
+        {
+            void apply_2x2(complex *__s, const complex (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void scale(complex *__p, const std::size_t &count, const complex &c);
+            void scale_periodic(complex *__p, const std::size_t &count, const complex *__c);
+            void apply_diagonal(complex *__s, const complex &d0, const complex &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void swap_pairs(complex *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void apply_dense(complex *__s, const dense_plan<double> &__p, const std::size_t &_begin, const std::size_t &_end);
+
+            // single precision: twice the amplitudes per register, permutations and dense blocks use the scalar templates
+            void apply_2x2(complex_f *__s, const complex_f (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void scale(complex_f *__p, const std::size_t &count, const complex_f &c);
+            void scale_periodic(complex_f *__p, const std::size_t &count, const complex_f *__c);
+            void apply_diagonal(complex_f *__s, const complex_f &d0, const complex_f &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+        }
+
+        namespace avx512
+        {
+            void apply_2x2(complex *__s, const complex (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void scale(complex *__p, const std::size_t &count, const complex &c);
+            void scale_periodic(complex *__p, const std::size_t &count, const complex *__c);
+            void apply_diagonal(complex *__s, const complex &d0, const complex &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void swap_pairs(complex *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void apply_dense(complex *__s, const dense_plan<double> &__p, const std::size_t &_begin, const std::size_t &_end);
+
+            // single precision: twice the amplitudes per register, permutations and dense blocks use the scalar templates
+            void apply_2x2(complex_f *__s, const complex_f (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+            void scale(complex_f *__p, const std::size_t &count, const complex_f &c);
+            void scale_periodic(complex_f *__p, const std::size_t &count, const complex_f *__c);
+            void apply_diagonal(complex_f *__s, const complex_f &d0, const complex_f &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end);
+        }
+#endif
+    }
+}
+
+#endif
@@ -0,0 +1,448 @@
+/**
+ * @file kernels.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./isa.hh"
+#include "../threading/thread_pool.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__unix__)
+#include <unistd.h>
+#endif
+
+#if defined(SIMULATOR_KERNELS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace simulator
+{
+    namespace kernels
+    {
+        // ranges handed to a thread always start at a multiple of this many pairs, which keeps every SIMD variant on full registers
+        static constexpr std::size_t pair_grain = 64;
+
+        template <typename T>
+        struct dispatch_table
+        {
+            isa_type isa;
+            fn_2x2<T> apply_2x2;
+            fn_scale<T> scale;
+            fn_scale_periodic<T> scale_periodic;
+            fn_diagonal<T> apply_diagonal;
+            fn_swap_pairs<T> swap_pairs;
+            fn_dense<T> apply_dense;
+        };
+
+        static isa_type detect_isa()
+        {
+#if defined(SIMULATOR_KERNELS_X86) && defined(__GNUC__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return isa_type::ISA_AVX512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return isa_type::ISA_AVX2;
+            if (__builtin_cpu_supports("sse4.2"))
+                return isa_type::ISA_SSE42;
+#elif defined(SIMULATOR_KERNELS_X86) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            const bool sse42 = (info[2] >> 20) & 1, osxsave = (info[2] >> 27) & 1, avx = (info[2] >> 28) & 1, fma = (info[2] >> 12) & 1;
+            __cpuidex(info, 7, 0);
+            const bool avx2 = (info[1] >> 5) & 1, avx512f = (info[1] >> 16) & 1;
+            const unsigned long long xcr0 = (osxsave && avx) ? _xgetbv(0) : 0;
+
+            if (avx2 && fma && avx512f && (xcr0 & 0xE6) == 0xE6)
+                return isa_type::ISA_AVX512;
+            if (avx2 && fma && (xcr0 & 0x6) == 0x6)
+                return isa_type::ISA_AVX2;
+            if (sse42)
+                return isa_type::ISA_SSE42;
+#endif
+            return isa_type::ISA_SCALAR;
+        }
+
+        // the single-precision tables only have SIMD 2x2/diagonal/scale/periodic scale kernels, permutations and dense blocks stay scalar
+        template <typename T>
+        static dispatch_table<T> make_table(const isa_type &__isa)
+        {
+            if constexpr (std::is_same_v<T, double>)
+            {
+                switch (__isa)
+                {
+#if defined(SIMULATOR_KERNELS_X86)
+                case isa_type::ISA_AVX512:
+                    return {__isa, avx512::apply_2x2, avx512::scale, avx512::scale_periodic, avx512::apply_diagonal, avx512::swap_pairs, avx512::apply_dense};
+                case isa_type::ISA_AVX2:
+                    return {__isa, avx2::apply_2x2, avx2::scale, avx2::scale_periodic, avx2::apply_diagonal, avx2::swap_pairs, avx2::apply_dense};
+                case isa_type::ISA_SSE42:
+                    return {__isa, sse42::apply_2x2, sse42::scale, sse42::scale_periodic, sse42::apply_diagonal, sse42::swap_pairs, sse42::apply_dense};
+#endif
+                default:
+                    break;
+                }
+            }
+            else
+            {
+                switch (__isa)
+                {
+#if defined(SIMULATOR_KERNELS_X86)
+                case isa_type::ISA_AVX512:
+                    return {__isa, avx512::apply_2x2, avx512::scale, avx512::scale_periodic, avx512::apply_diagonal, scalar::swap_pairs<T>, scalar::apply_dense<T>};
+                case isa_type::ISA_AVX2:
+                    return {__isa, avx2::apply_2x2, avx2::scale, avx2::scale_periodic, avx2::apply_diagonal, scalar::swap_pairs<T>, scalar::apply_dense<T>};
+                case isa_type::ISA_SSE42:
+                    return {__isa, sse42::apply_2x2, sse42::scale, sse42::scale_periodic, sse42::apply_diagonal, scalar::swap_pairs<T>, scalar::apply_dense<T>};
+#endif
+                default:
+                    break;
+                }
+            }
+            return {isa_type::ISA_SCALAR, scalar::apply_2x2<T>, scalar::scale<T>, scalar::scale_periodic<T>, scalar::apply_diagonal<T>, scalar::swap_pairs<T>, scalar::apply_dense<T>};
+        }
+
+        // resolved once per precision, on first use (the server touches it at startup to report the variant)
+        template <typename T>
+        static const dispatch_table<T> &table()
+        {
+            static const dispatch_table<T> tbl = make_table<T>(detect_isa());
+            return tbl;
+        }
+
+        isa_type selected_isa()
+        {
+            return table<double>().isa;
+        }
+
+        const char *isa_name(const isa_type &__isa)
+        {
+            switch (__isa)
+            {
+            case isa_type::ISA_AVX512:
+                return "avx512";
+            case isa_type::ISA_AVX2:
+                return "avx2";
+            case isa_type::ISA_SSE42:
+                return "sse4.2";
+            default:
+                return "scalar";
+            }
+        }
+
+        static std::size_t detect_tile_qubits()
+        {
+            if (const char *env = std::getenv("QUBITVERSE_TILE_QUBITS"))
+            {
+                const std::size_t q = std::strtoull(env, nullptr, 10);
+                if (q >= 2 && q < 48)
+                    return q;
+            }
+
+            std::size_t l2 = 1ULL << 20; // assumed when the OS does not report it
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+            const long reported = sysconf(_SC_LEVEL2_CACHE_SIZE);
+            if (reported > 0)
+                l2 = static_cast<std::size_t>(reported);
+#endif
+            // half of the L2 for the tile, the rest stays free for the code, the stack and the hardware prefetchers
+            std::size_t q = 2;
+            while ((sizeof(complex) << (q + 1)) <= l2 / 2)
+                q++;
+            return q;
+        }
+
+        std::size_t tile_qubits()
+        {
+            static const std::size_t q = detect_tile_qubits();
+            return q;
+        }
+
+        template <typename T>
+        void apply_2x2(std::complex<T> *__s, const std::size_t &_len, const std::complex<T> (&__m)[2][2], const std::size_t &q_target)
+        {
+            const std::size_t stride = 1ULL << q_target;
+            const fn_2x2<T> fn = table<T>().apply_2x2;
+            thread_pool::get().parallel_for(_len / 2, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            { fn(__s, __m, stride, b, e); });
+        }
+
+        template <typename T>
+        void apply_pauli_x(std::complex<T> *__s, const std::size_t &_len, const std::size_t &q_target)
+        {
+            const std::size_t stride = 1ULL << q_target;
+            const fn_swap_pairs<T> fn = table<T>().swap_pairs;
+            thread_pool::get().parallel_for(_len / 2, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            { fn(__s, stride, b, e); });
+        }
+
+        template <typename T>
+        void apply_cnot(std::complex<T> *__s, const std::size_t &_len, const std::size_t &q_control, const std::size_t &q_target)
+        {
+            const std::size_t control = 1ULL << q_control, target = 1ULL << q_target;
+            if (q_control < q_target)
+            {
+                thread_pool::get().parallel_for(_len / 4, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                                { scalar::apply_cnot<T>(__s, control, target, b, e); });
+                return;
+            }
+
+            // the control=1 half is made of contiguous blocks of 2^q_control amplitudes, inside each one CNOT is a plain X on
+            // the target, so the ISA permutation kernel (with its in-register shuffles for low targets) does the work
+            const std::size_t half = control / 2; // target pairs per block
+            const fn_swap_pairs<T> fn = table<T>().swap_pairs;
+            thread_pool::get().parallel_for(_len / 4, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            {
+                for (std::size_t q = b; q < e;)
+                {
+                    const std::size_t k = q / half, off = q % half;
+                    const std::size_t run = half - off < e - q ? half - off : e - q;
+                    fn(__s + (2 * k + 1) * control, target, off, off + run);
+                    q += run;
+                } });
+        }
+
+        template <typename T>
+        void apply_cz(std::complex<T> *__s, const std::size_t &_len, const std::size_t &q_control, const std::size_t &q_target)
+        {
+            const std::size_t control = 1ULL << q_control, target = 1ULL << q_target;
+            thread_pool::get().parallel_for(_len / 4, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            { scalar::apply_cz<T>(__s, control, target, b, e); });
+        }
+
+        template <typename T>
+        void apply_swap(std::complex<T> *__s, const std::size_t &_len, const std::size_t &qubit_1, const std::size_t &qubit_2)
+        {
+            const std::size_t q1 = 1ULL << qubit_1, q2 = 1ULL << qubit_2;
+            thread_pool::get().parallel_for(_len / 4, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            { scalar::apply_swap<T>(__s, q1, q2, b, e); });
+        }
+
+        template <typename T>
+        void apply_diagonal(std::complex<T> *__s, const std::size_t &_len, const std::complex<T> &d0, const std::complex<T> &d1, const std::size_t &q_target)
+        {
+            const std::complex<T> one = {1.0, 0.0};
+            if (d0 == one && d1 == one)
+                return;
+
+            const std::size_t stride = 1ULL << q_target;
+            const fn_diagonal<T> fn = table<T>().apply_diagonal;
+            thread_pool::get().parallel_for(_len / 2, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            { fn(__s, d0, d1, stride, b, e); });
+        }
+
+        template <typename T>
+        void apply_phase_table(std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &qubits, const std::vector<std::complex<T>> &phases)
+        {
+            if (qubits.empty())
+                return;
+
+            const std::complex<T> one = {1.0, 0.0};
+            if (_len < 8)
+            {
+                for (std::size_t i = 0; i < _len; i++)
+                {
+                    std::size_t idx = 0;
+                    for (std::size_t m = 0; m < qubits.size(); m++)
+                        idx |= ((i >> qubits[m]) & 1) << m;
+                    __s[i] *= phases[idx];
+                }
+                return;
+            }
+
+            // qubits 0-2 vary inside every 8 amplitudes and go into a period-8 pattern, the higher run qubits are constant over
+            // blocks of 2^(lowest of them) amplitudes: one pattern per value of the high bits, picked once per block
+            std::size_t low_bits = 0, high_bits = 0, lowest_high = 64;
+            std::vector<std::size_t> high;
+            for (std::size_t m = 0; m < qubits.size(); m++)
+            {
+                if (qubits[m] < 3)
+                    low_bits |= 1ULL << m;
+                else
+                {
+                    high_bits |= 1ULL << m;
+                    high.push_back(qubits[m]);
+                    lowest_high = std::min(lowest_high, qubits[m]);
+                }
+            }
+            const std::size_t block = high.empty() ? _len : 1ULL << lowest_high;
+
+            // pattern h holds the phases of the 8 lanes when bit j of the high index is the bit of `high[j]`
+            std::vector<std::complex<T>> patterns((1ULL << high.size()) * 8);
+            std::vector<unsigned char> uniform(1ULL << high.size()), identity(1ULL << high.size());
+            for (std::size_t h = 0; h < (1ULL << high.size()); h++)
+            {
+                std::size_t hidx = 0;
+                for (std::size_t m = 0, j = 0; m < qubits.size(); m++)
+                    if ((high_bits >> m) & 1)
+                        hidx |= ((h >> j++) & 1) << m;
+                uniform[h] = identity[h] = 1;
+                for (std::size_t l = 0; l < 8; l++)
+                {
+                    std::size_t idx = hidx;
+                    for (std::size_t m = 0; m < qubits.size(); m++)
+                        if ((low_bits >> m) & 1)
+                            idx |= ((l >> qubits[m]) & 1) << m;
+                    patterns[8 * h + l] = phases[idx];
+                    uniform[h] &= phases[idx] == patterns[8 * h];
+                    identity[h] &= phases[idx] == one;
+                }
+            }
+
+            const fn_scale<T> scale = table<T>().scale;
+            const fn_scale_periodic<T> periodic = table<T>().scale_periodic;
+            thread_pool::get().parallel_for(_len, pair_grain * 2, [&](const std::size_t &b, const std::size_t &e)
+                                            {
+                for (std::size_t i = b; i < e;)
+                {
+                    const std::size_t run = std::min(e, (i | (block - 1)) + 1) - i;
+                    std::size_t h = 0;
+                    for (std::size_t j = 0; j < high.size(); j++)
+                        h |= ((i >> high[j]) & 1) << j;
+                    const std::complex<T> *pattern = patterns.data() + 8 * h;
+                    if (uniform[h] && !identity[h])
+                        scale(__s + i, run, pattern[0]);
+                    else if (!uniform[h])
+                        periodic(__s + i, run, pattern);
+                    i += run;
+                } });
+        }
+
+        template <typename T>
+        void apply_dense(std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &qubits, const std::vector<std::complex<T>> &matrix)
+        {
+            dense_plan<T> plan;
+            plan.M_count = qubits.size();
+            plan.M_dim = 1ULL << plan.M_count;
+            plan.M_matrix = matrix.data();
+            for (std::size_t j = 0; j < plan.M_count; j++)
+                plan.M_strides[j] = 1ULL << qubits[j];
+            std::sort(plan.M_strides, plan.M_strides + plan.M_count);
+            for (std::size_t r = 0; r < plan.M_dim; r++)
+            {
+                plan.M_offsets[r] = 0;
+                for (std::size_t j = 0; j < plan.M_count; j++)
+                    plan.M_offsets[r] |= ((r >> j) & 1) << qubits[j];
+            }
+
+            const fn_dense<T> fn = table<T>().apply_dense;
+            thread_pool::get().parallel_for(_len >> plan.M_count, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            { fn(__s, plan, b, e); });
+        }
+
+        template <typename T>
+        void apply_projector(std::complex<T> *__s, const std::size_t &_len, const std::size_t &mask, const std::size_t &outcome, const std::complex<T> &c)
+        {
+            const std::size_t block = mask ? (mask & (~mask + 1)) : _len;
+            const fn_scale<T> fn = table<T>().scale;
+            thread_pool::get().parallel_for(_len, pair_grain, [&](const std::size_t &b, const std::size_t &e)
+                                            {
+                // runs shorter than a cache line are not worth a call each
+                if (block < 8)
+                {
+                    const T cr = c.real(), ci = c.imag();
+                    T *d = reinterpret_cast<T *>(__s);
+                    for (std::size_t i = b; i < e; i++)
+                    {
+                        const T keep = (i & mask) == outcome ? T(1) : T(0), re = d[2 * i] * keep, im = d[2 * i + 1] * keep;
+                        d[2 * i] = re * cr - im * ci;
+                        d[2 * i + 1] = re * ci + im * cr;
+                    }
+                    return;
+                }
+                for (std::size_t i = b; i < e;)
+                {
+                    const std::size_t run = std::min(block - (i & (block - 1)), e - i);
+                    if ((i & mask) == outcome)
+                        fn(__s + i, run, c);
+                    else
+                        std::memset(static_cast<void *>(__s + i), 0, run * sizeof(std::complex<T>));
+                    i += run;
+                } });
+        }
+
+        // calls `transform(w, size)` on the probabilities of every chunk of up to 64 amplitudes, then adds
+        // `select(chunk start, mask)` of every mask into `__out`, see z_parities
+        template <typename T, typename TRANSFORM, typename SELECT>
+        static void chunk_sums(const std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &masks, std::vector<double> &__out, TRANSFORM &&transform, SELECT &&select)
+        {
+            static constexpr std::size_t slots = 64;
+            const std::size_t chunk = std::min<std::size_t>(_len, 64), nchunks = _len / chunk, per_slot = (nchunks + slots - 1) / slots;
+            const std::size_t k = masks.size();
+            std::vector<double> partial(slots * k, 0.0);
+
+            thread_pool::get().parallel_for(_len, per_slot * chunk, [&](const std::size_t &b, const std::size_t &e)
+                                            {
+                double w[64];
+                for (std::size_t c = b / chunk; c * chunk < e; c++)
+                {
+                    const T *d = reinterpret_cast<const T *>(__s + c * chunk);
+                    for (std::size_t j = 0; j < chunk; j++)
+                        w[j] = double(d[2 * j]) * d[2 * j] + double(d[2 * j + 1]) * d[2 * j + 1];
+                    transform(w, chunk);
+                    double *out = partial.data() + (c / per_slot) * k;
+                    for (std::size_t m = 0; m < k; m++)
+                        out[m] += select(w, c * chunk, masks[m]);
+                } });
+
+            for (std::size_t step = 1; step < slots; step <<= 1)
+                for (std::size_t s = 0; s + step < slots; s += step << 1)
+                    for (std::size_t m = 0; m < k; m++)
+                        partial[s * k + m] += partial[(s + step) * k + m];
+            __out.assign(partial.begin(), partial.begin() + k);
+        }
+
+        template <typename T>
+        void z_parities(const std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &masks, std::vector<double> &__out)
+        {
+            const std::size_t low = std::min<std::size_t>(_len, 64) - 1;
+            chunk_sums(__s, _len, masks, __out, [](double *w, const std::size_t &size)
+                       {
+                for (std::size_t h = 1; h < size; h <<= 1)
+                    for (std::size_t j = 0; j < size; j += h << 1)
+                        for (std::size_t i = j; i < j + h; i++)
+                        {
+                            const double x = w[i], y = w[i + h];
+                            w[i] = x + y;
+                            w[i + h] = x - y;
+                        } }, [low](const double *w, const std::size_t &first, const std::size_t &mask)
+                       { return std::popcount(first & mask) & 1 ? -w[mask & low] : w[mask & low]; });
+        }
+
+        template <typename T>
+        void all_set_probabilities(const std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &masks, std::vector<double> &__out)
+        {
+            const std::size_t low = std::min<std::size_t>(_len, 64) - 1;
+            chunk_sums(__s, _len, masks, __out, [](double *w, const std::size_t &size)
+                       {
+                for (std::size_t h = 1; h < size; h <<= 1)
+                    for (std::size_t j = 0; j < size; j++)
+                        if (!(j & h))
+                            w[j] += w[j | h]; }, [low](const double *w, const std::size_t &first, const std::size_t &mask)
+                       { return (first & mask & ~low) == (mask & ~low) ? w[mask & low] : 0.0; });
+        }
+
+#define SIMULATOR_KERNELS_INSTANTIATE(T)                                                                                                                                    \
+    template void apply_2x2<T>(std::complex<T> *, const std::size_t &, const std::complex<T>(&)[2][2], const std::size_t &);                                                \
+    template void apply_pauli_x<T>(std::complex<T> *, const std::size_t &, const std::size_t &);                                                                            \
+    template void apply_cnot<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &);                                                          \
+    template void apply_cz<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &);                                                            \
+    template void apply_swap<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &);                                                          \
+    template void apply_diagonal<T>(std::complex<T> *, const std::size_t &, const std::complex<T> &, const std::complex<T> &, const std::size_t &);                         \
+    template void apply_phase_table<T>(std::complex<T> *, const std::size_t &, const std::vector<std::size_t> &, const std::vector<std::complex<T>> &);                     \
+    template void apply_dense<T>(std::complex<T> *, const std::size_t &, const std::vector<std::size_t> &, const std::vector<std::complex<T>> &);                           \
+    template void apply_projector<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &, const std::complex<T> &);                            \
+    template void z_parities<T>(const std::complex<T> *, const std::size_t &, const std::vector<std::size_t> &, std::vector<double> &);                                     \
+    template void all_set_probabilities<T>(const std::complex<T> *, const std::size_t &, const std::vector<std::size_t> &, std::vector<double> &);
+
+        SIMULATOR_KERNELS_INSTANTIATE(double)
+        SIMULATOR_KERNELS_INSTANTIATE(float)
+
+#undef SIMULATOR_KERNELS_INSTANTIATE
+    }
+}
@@ -0,0 +1,94 @@
+/**
+ * @file kernels.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_KERNELS
+#define SIMULATOR_KERNELS
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace simulator
+{
+    namespace kernels
+    {
+        using complex = std::complex<double>;
+        // amplitude type of the single-precision mode: half the memory and twice the amplitudes per SIMD register
+        using complex_f = std::complex<float>;
+
+        // largest block the dense kernel applies in one sweep, a 2^5 x 2^5 matrix
+        static constexpr std::size_t max_dense_qubits = 5;
+
+        // instruction-set variants every kernel is built for, the best one supported by the CPU is picked once at startup
+        enum isa_type : unsigned char
+        {
+            ISA_SCALAR,
+            ISA_SSE42,
+            ISA_AVX2,
+            ISA_AVX512
+        };
+
+        [[nodiscard]] isa_type selected_isa();
+        [[nodiscard]] const char *isa_name(const isa_type &__isa);
+
+        // log2 of the number of amplitudes in one cache-resident tile: half of the L2 cache, or `QUBITVERSE_TILE_QUBITS`
+        // (sized for double-precision amplitudes, a single-precision tile holds one qubit more)
+        [[nodiscard]] std::size_t tile_qubits();
+
+        // every kernel below is a template on the amplitude's scalar type, instantiated for double and float in kernels.cc
+
+        // applies a 2x2 unitary on `q_target` over the whole vector-space of `_len` amplitudes
+        // AVX-512 handles 4 amplitude pairs, AVX2 handles 2 amplitude pairs per instruction and SSE4.2 handles one pair per instruction
+        // whatever the vector unit cannot cover (low strides) falls back to the next narrower variant
+        template <typename T>
+        void apply_2x2(std::complex<T> *__s, const std::size_t &_len, const std::complex<T> (&__m)[2][2], const std::size_t &q_target);
+
+        // diagonal gate diag(d0, d1) on `q_target`, only the amplitudes that need a phase are touched:
+        // the |1> half when d0 == 1 (Z, S, T, P), both halves scaled by a scalar otherwise (Rz)
+        template <typename T>
+        void apply_diagonal(std::complex<T> *__s, const std::size_t &_len, const std::complex<T> &d0, const std::complex<T> &d1, const std::size_t &q_target);
+
+        // multiplies every amplitude by `phases[k]`, where bit m of `k` is the bit `qubits[m]` of the amplitude's index
+        // a run of diagonal gates collapses into one such table and costs a single sweep, entries equal to 1 are skipped
+        template <typename T>
+        void apply_phase_table(std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &qubits, const std::vector<std::complex<T>> &phases);
+
+        // applies a dense 2^k x 2^k unitary (row-major, bit j of a row/column index is `qubits[j]`) over k <= max_dense_qubits
+        // qubits in one sweep: every group of 2^k amplitudes is gathered, multiplied and scattered back
+        template <typename T>
+        void apply_dense(std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &qubits, const std::vector<std::complex<T>> &matrix);
+
+        // measurement collapse: keeps the amplitudes whose bits under `mask` equal `outcome` and multiplies them by `c`, clears
+        // the others, runs of 2^(lowest bit of mask) amplitudes share one decision, so wide runs are a memset or a SIMD scale
+        template <typename T>
+        void apply_projector(std::complex<T> *__s, const std::size_t &_len, const std::size_t &mask, const std::size_t &outcome, const std::complex<T> &c);
+        // sum of |a_i|^2 * (-1)^popcount(i & mask) (the expectation of the Z-string `mask`) for every mask, in one pass: each
+        // chunk of 64 probabilities goes through a Walsh-Hadamard transform, which gives the sign sums of all masks over the
+        // low 6 bits at once, the higher bits are constant over the chunk and cost a popcount per mask
+        // the chunks are summed in fixed slots and the slots pairwise, so the result does not depend on the thread count
+        template <typename T>
+        void z_parities(const std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &masks, std::vector<double> &__out);
+        // sum of |a_i|^2 over the indices with every bit of `mask` set, for every mask (the probability of a boolean monomial),
+        // the same way but with a superset-sum transform of each chunk
+        template <typename T>
+        void all_set_probabilities(const std::complex<T> *__s, const std::size_t &_len, const std::vector<std::size_t> &masks, std::vector<double> &__out);
+        // X, CNOT and SWAP are permutations: they exchange blocks of amplitudes (whole 2^target runs when the stride is large,
+        // register shuffles when it is small) and never multiply anything
+        template <typename T>
+        void apply_pauli_x(std::complex<T> *__s, const std::size_t &_len, const std::size_t &q_target);
+
+        // two-qubit gates enumerate only the quarter(s) of the vector-space they change, by inserting the two fixed bits into a
+        // compact counter: CZ negates the |11> quarter, CNOT swaps |10> with |11>, SWAP swaps |01> with |10>
+        template <typename T>
+        void apply_cnot(std::complex<T> *__s, const std::size_t &_len, const std::size_t &q_control, const std::size_t &q_target);
+        template <typename T>
+        void apply_cz(std::complex<T> *__s, const std::size_t &_len, const std::size_t &q_control, const std::size_t &q_target);
+        template <typename T>
+        void apply_swap(std::complex<T> *__s, const std::size_t &_len, const std::size_t &qubit_1, const std::size_t &qubit_2);
+    }
+}
+
+#endif
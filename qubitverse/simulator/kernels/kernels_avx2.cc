@@ -0,0 +1,406 @@
+/**
+ * @file kernels_avx2.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./isa.hh"
+
+#if defined(SIMULATOR_KERNELS_X86)
+#include <immintrin.h>
+
+#define SIMULATOR_AVX2 SIMULATOR_TARGET("avx2,fma")
+
+namespace simulator
+{
+    namespace kernels
+    {
+        namespace avx2
+        {
+            // (__m0 * a) + (__m1 * b) for two complex numbers per register, __m0/__m1 are split in broadcast real and imaginary parts
+            SIMULATOR_AVX2 static inline __m256d cmul2(const __m256d &a, const __m256d &b, const __m256d &m0r, const __m256d &m0i, const __m256d &m1r, const __m256d &m1i)
+            {
+                __m256d t = _mm256_mul_pd(_mm256_permute_pd(a, 0x5), m0i); // (ai, ar) * m0i
+                t = _mm256_fmadd_pd(_mm256_permute_pd(b, 0x5), m1i, t);    // + (bi, br) * m1i
+                const __m256d r = _mm256_fmaddsub_pd(a, m0r, t);           // (ar * m0r - t0, ai * m0r + t1)
+                return _mm256_fmadd_pd(b, m1r, r);
+            }
+
+            // target 0: one register is one whole pair, swapping its 128-bit halves lines every amplitude up with its partner, so
+            // the matrix is applied with lane-varying coefficients, (m00, m11) on the diagonal and (m01, m10) across
+            // target 1: two neighbouring registers hold two whole pairs, and the run bookkeeping folds away with a constant stride
+            template <std::size_t stride>
+            SIMULATOR_AVX2 static void apply_2x2_low(complex *__s, const complex (&__m)[2][2], const std::size_t &_begin, const std::size_t &_end)
+            {
+                static_assert(stride == 1 || stride == 2, "only targets 0 and 1 have a low-stride kernel");
+                double *d = reinterpret_cast<double *>(__s);
+                std::size_t p = _begin;
+                if constexpr (stride == 1)
+                {
+                    const __m256d dr = _mm256_setr_pd(__m[0][0].real(), __m[0][0].real(), __m[1][1].real(), __m[1][1].real());
+                    const __m256d di = _mm256_setr_pd(__m[0][0].imag(), __m[0][0].imag(), __m[1][1].imag(), __m[1][1].imag());
+                    const __m256d xr = _mm256_setr_pd(__m[0][1].real(), __m[0][1].real(), __m[1][0].real(), __m[1][0].real());
+                    const __m256d xi = _mm256_setr_pd(__m[0][1].imag(), __m[0][1].imag(), __m[1][0].imag(), __m[1][0].imag());
+                    for (; p < _end; p++)
+                    {
+                        const __m256d v = _mm256_loadu_pd(d + 4 * p);
+                        _mm256_storeu_pd(d + 4 * p, cmul2(v, _mm256_permute4x64_pd(v, 0x4E), dr, di, xr, xi));
+                    }
+                }
+                else
+                {
+                    const __m256d m00r = _mm256_set1_pd(__m[0][0].real()), m00i = _mm256_set1_pd(__m[0][0].imag());
+                    const __m256d m01r = _mm256_set1_pd(__m[0][1].real()), m01i = _mm256_set1_pd(__m[0][1].imag());
+                    const __m256d m10r = _mm256_set1_pd(__m[1][0].real()), m10i = _mm256_set1_pd(__m[1][0].imag());
+                    const __m256d m11r = _mm256_set1_pd(__m[1][1].real()), m11i = _mm256_set1_pd(__m[1][1].imag());
+                    if (p < _end && (p & 1))
+                    {
+                        scalar::apply_2x2(__s, __m, stride, p, p + 1);
+                        p++;
+                    }
+                    for (; p + 2 <= _end; p += 2)
+                    {
+                        double *p0 = d + 2 * pair_base(p, stride);
+                        const __m256d a = _mm256_loadu_pd(p0);
+                        const __m256d b = _mm256_loadu_pd(p0 + 4);
+
+                        _mm256_storeu_pd(p0, cmul2(a, b, m00r, m00i, m01r, m01i));
+                        _mm256_storeu_pd(p0 + 4, cmul2(a, b, m10r, m10i, m11r, m11i));
+                    }
+                    if (p < _end)
+                        scalar::apply_2x2(__s, __m, stride, p, _end);
+                }
+            }
+
+            SIMULATOR_AVX2 void apply_2x2(complex *__s, const complex (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_2x2_low<1>(__s, __m, _begin, _end);
+                if (stride == 2)
+                    return apply_2x2_low<2>(__s, __m, _begin, _end);
+
+                const __m256d m00r = _mm256_set1_pd(__m[0][0].real()), m00i = _mm256_set1_pd(__m[0][0].imag());
+                const __m256d m01r = _mm256_set1_pd(__m[0][1].real()), m01i = _mm256_set1_pd(__m[0][1].imag());
+                const __m256d m10r = _mm256_set1_pd(__m[1][0].real()), m10i = _mm256_set1_pd(__m[1][0].imag());
+                const __m256d m11r = _mm256_set1_pd(__m[1][1].real()), m11i = _mm256_set1_pd(__m[1][1].imag());
+
+                const bool prefetch = stride >= prefetch_min_stride<double>;
+                double *d = reinterpret_cast<double *>(__s);
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; j += 2)
+                    {
+                        double *p0 = d + 2 * j;
+                        double *p1 = d + 2 * (j + stride);
+                        if (prefetch)
+                        {
+                            _mm_prefetch(reinterpret_cast<const char *>(p0) + prefetch_ahead, _MM_HINT_T0);
+                            _mm_prefetch(reinterpret_cast<const char *>(p1) + prefetch_ahead, _MM_HINT_T0);
+                        }
+
+                        const __m256d a = _mm256_loadu_pd(p0);
+                        const __m256d b = _mm256_loadu_pd(p1);
+
+                        _mm256_storeu_pd(p0, cmul2(a, b, m00r, m00i, m01r, m01i));
+                        _mm256_storeu_pd(p1, cmul2(a, b, m10r, m10i, m11r, m11i));
+                    }
+                    p += run;
+                }
+            }
+
+            SIMULATOR_AVX2 void scale(complex *__p, const std::size_t &count, const complex &c)
+            {
+                const __m256d cr = _mm256_set1_pd(c.real()), ci = _mm256_set1_pd(c.imag());
+                double *d = reinterpret_cast<double *>(__p);
+                std::size_t j = 0;
+                for (; j + 2 <= count; j += 2)
+                {
+                    const __m256d v = _mm256_loadu_pd(d + 2 * j);
+                    _mm256_storeu_pd(d + 2 * j, _mm256_fmaddsub_pd(v, cr, _mm256_mul_pd(_mm256_permute_pd(v, 0x5), ci)));
+                }
+                if (j < count)
+                    scalar::scale(__p + j, count - j, c);
+            }
+
+            SIMULATOR_AVX2 void scale_periodic(complex *__p, const std::size_t &count, const complex *__c)
+            {
+                __m256d cr[4], ci[4];
+                for (std::size_t l = 0; l < 4; l++)
+                {
+                    cr[l] = _mm256_setr_pd(__c[2 * l].real(), __c[2 * l].real(), __c[2 * l + 1].real(), __c[2 * l + 1].real());
+                    ci[l] = _mm256_setr_pd(__c[2 * l].imag(), __c[2 * l].imag(), __c[2 * l + 1].imag(), __c[2 * l + 1].imag());
+                }
+                double *d = reinterpret_cast<double *>(__p);
+                std::size_t j = 0;
+                for (; j + 8 <= count; j += 8)
+                    for (std::size_t l = 0; l < 4; l++)
+                    {
+                        const __m256d v = _mm256_loadu_pd(d + 2 * j + 4 * l);
+                        _mm256_storeu_pd(d + 2 * j + 4 * l, _mm256_fmaddsub_pd(v, cr[l], _mm256_mul_pd(_mm256_permute_pd(v, 0x5), ci[l])));
+                    }
+                if (j < count)
+                    scalar::scale_periodic(__p + j, count - j, __c);
+            }
+
+            // target 0: one register is one pair, multiplied by (d0, d1) lane-wise
+            SIMULATOR_AVX2 static void apply_diagonal_low(complex *__s, const complex &d0, const complex &d1, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const __m256d cr = _mm256_setr_pd(d0.real(), d0.real(), d1.real(), d1.real());
+                const __m256d ci = _mm256_setr_pd(d0.imag(), d0.imag(), d1.imag(), d1.imag());
+                double *d = reinterpret_cast<double *>(__s);
+                for (std::size_t p = _begin; p < _end; p++)
+                {
+                    const __m256d v = _mm256_loadu_pd(d + 4 * p);
+                    _mm256_storeu_pd(d + 4 * p, _mm256_fmaddsub_pd(v, cr, _mm256_mul_pd(_mm256_permute_pd(v, 0x5), ci)));
+                }
+            }
+
+            SIMULATOR_AVX2 void apply_diagonal(complex *__s, const complex &d0, const complex &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_diagonal_low(__s, d0, d1, _begin, _end);
+
+                const bool skip0 = d0.real() == 1.0 && d0.imag() == 0.0;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    if (!skip0)
+                        scale(__s + i, run, d0);
+                    scale(__s + i + stride, run, d1);
+                    p += run;
+                }
+            }
+
+            SIMULATOR_AVX2 void swap_pairs(complex *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                double *d = reinterpret_cast<double *>(__s);
+                if (stride == 1)
+                {
+                    // both amplitudes of a pair sit in one register, swapping its 128-bit halves is the whole gate
+                    for (std::size_t p = _begin; p < _end; p++)
+                        _mm256_storeu_pd(d + 4 * p, _mm256_permute4x64_pd(_mm256_loadu_pd(d + 4 * p), 0x4E));
+                    return;
+                }
+
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    std::size_t j = i;
+                    for (; j + 2 <= i + run; j += 2)
+                    {
+                        const __m256d a = _mm256_loadu_pd(d + 2 * j);
+                        const __m256d b = _mm256_loadu_pd(d + 2 * (j + stride));
+                        _mm256_storeu_pd(d + 2 * j, b);
+                        _mm256_storeu_pd(d + 2 * (j + stride), a);
+                    }
+                    if (j < i + run)
+                        std::swap(__s[j], __s[j + stride]);
+                    p += run;
+                }
+            }
+
+            // groups whose bases are contiguous (below the block's lowest qubit) are processed 2 at a time, one lane per group
+            SIMULATOR_AVX2 void apply_dense(complex *__s, const dense_plan<double> &__p, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (__p.M_strides[0] < 2)
+                    return scalar::apply_dense(__s, __p, _begin, _end);
+
+                const std::size_t dim = __p.M_dim;
+                const double *u = reinterpret_cast<const double *>(__p.M_matrix);
+                double *d = reinterpret_cast<double *>(__s);
+                __m256d v[1ULL << max_dense_qubits];
+
+                for (std::size_t k = _begin; k < _end;)
+                {
+                    const std::size_t base = dense_base(k, __p), run = pair_run(k, __p.M_strides[0], _end);
+                    std::size_t j = 0;
+                    for (; j + 2 <= run; j += 2)
+                    {
+                        for (std::size_t c = 0; c < dim; c++)
+                            v[c] = _mm256_loadu_pd(d + 2 * (base + j + __p.M_offsets[c]));
+                        for (std::size_t r = 0; r < dim; r++)
+                        {
+                            const double *row = u + 2 * r * dim;
+                            __m256d re = _mm256_setzero_pd(), im = _mm256_setzero_pd();
+                            for (std::size_t c = 0; c < dim; c++)
+                            {
+                                re = _mm256_fmadd_pd(v[c], _mm256_set1_pd(row[2 * c]), re);
+                                im = _mm256_fmadd_pd(_mm256_permute_pd(v[c], 0x5), _mm256_set1_pd(row[2 * c + 1]), im);
+                            }
+                            _mm256_storeu_pd(d + 2 * (base + j + __p.M_offsets[r]), _mm256_addsub_pd(re, im));
+                        }
+                    }
+                    if (j < run)
+                        scalar::apply_dense(__s, __p, k + j, k + run);
+                    k += run;
+                }
+            }
+
+            // single precision: four complex numbers per register, same arithmetic as `cmul2` with the float permutes
+            SIMULATOR_AVX2 static inline __m256 cmul4f(const __m256 &a, const __m256 &b, const __m256 &m0r, const __m256 &m0i, const __m256 &m1r, const __m256 &m1i)
+            {
+                __m256 t = _mm256_mul_ps(_mm256_permute_ps(a, 0xB1), m0i);
+                t = _mm256_fmadd_ps(_mm256_permute_ps(b, 0xB1), m1i, t);
+                const __m256 r = _mm256_fmaddsub_ps(a, m0r, t);
+                return _mm256_fmadd_ps(b, m1r, r);
+            }
+
+            // a register holds two whole pairs for targets 0 and 1: amplitude-wise (c0, c1, c0, c1) and (c0, c0, c1, c1)
+            template <std::size_t stride>
+            SIMULATOR_AVX2 static inline __m256 lanes_f(const float &c0, const float &c1)
+            {
+                if constexpr (stride == 1)
+                    return _mm256_setr_ps(c0, c0, c1, c1, c0, c0, c1, c1);
+                else
+                    return _mm256_setr_ps(c0, c0, c0, c0, c1, c1, c1, c1);
+            }
+
+            // swaps neighbouring amplitudes for target 0, the 128-bit halves for target 1
+            template <std::size_t stride>
+            SIMULATOR_AVX2 static inline __m256 partner_f(const __m256 &v)
+            {
+                if constexpr (stride == 1)
+                    return _mm256_permute_ps(v, 0x4E);
+                else
+                    return _mm256_permute2f128_ps(v, v, 0x01);
+            }
+
+            template <std::size_t stride>
+            SIMULATOR_AVX2 static void apply_2x2_low(complex_f *__s, const complex_f (&__m)[2][2], const std::size_t &_begin, const std::size_t &_end)
+            {
+                const __m256 dr = lanes_f<stride>(__m[0][0].real(), __m[1][1].real()), di = lanes_f<stride>(__m[0][0].imag(), __m[1][1].imag());
+                const __m256 xr = lanes_f<stride>(__m[0][1].real(), __m[1][0].real()), xi = lanes_f<stride>(__m[0][1].imag(), __m[1][0].imag());
+
+                float *f = reinterpret_cast<float *>(__s);
+                std::size_t p = _begin;
+                if (stride == 2 && p < _end && (p & 1))
+                {
+                    scalar::apply_2x2(__s, __m, stride, p, p + 1);
+                    p++;
+                }
+                for (; p + 2 <= _end; p += 2)
+                {
+                    float *q = f + 2 * pair_base(p, stride);
+                    const __m256 v = _mm256_loadu_ps(q);
+                    _mm256_storeu_ps(q, cmul4f(v, partner_f<stride>(v), dr, di, xr, xi));
+                }
+                if (p < _end)
+                    scalar::apply_2x2(__s, __m, stride, p, _end);
+            }
+
+            SIMULATOR_AVX2 void apply_2x2(complex_f *__s, const complex_f (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_2x2_low<1>(__s, __m, _begin, _end);
+                if (stride == 2)
+                    return apply_2x2_low<2>(__s, __m, _begin, _end);
+
+                const __m256 m00r = _mm256_set1_ps(__m[0][0].real()), m00i = _mm256_set1_ps(__m[0][0].imag());
+                const __m256 m01r = _mm256_set1_ps(__m[0][1].real()), m01i = _mm256_set1_ps(__m[0][1].imag());
+                const __m256 m10r = _mm256_set1_ps(__m[1][0].real()), m10i = _mm256_set1_ps(__m[1][0].imag());
+                const __m256 m11r = _mm256_set1_ps(__m[1][1].real()), m11i = _mm256_set1_ps(__m[1][1].imag());
+
+                const bool prefetch = stride >= prefetch_min_stride<float>;
+                float *f = reinterpret_cast<float *>(__s);
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; j += 4)
+                    {
+                        float *p0 = f + 2 * j;
+                        float *p1 = f + 2 * (j + stride);
+                        if (prefetch)
+                        {
+                            _mm_prefetch(reinterpret_cast<const char *>(p0) + prefetch_ahead, _MM_HINT_T0);
+                            _mm_prefetch(reinterpret_cast<const char *>(p1) + prefetch_ahead, _MM_HINT_T0);
+                        }
+
+                        const __m256 a = _mm256_loadu_ps(p0);
+                        const __m256 b = _mm256_loadu_ps(p1);
+
+                        _mm256_storeu_ps(p0, cmul4f(a, b, m00r, m00i, m01r, m01i));
+                        _mm256_storeu_ps(p1, cmul4f(a, b, m10r, m10i, m11r, m11i));
+                    }
+                    p += run;
+                }
+            }
+
+            SIMULATOR_AVX2 void scale(complex_f *__p, const std::size_t &count, const complex_f &c)
+            {
+                const __m256 cr = _mm256_set1_ps(c.real()), ci = _mm256_set1_ps(c.imag());
+                float *f = reinterpret_cast<float *>(__p);
+                std::size_t j = 0;
+                for (; j + 4 <= count; j += 4)
+                {
+                    const __m256 v = _mm256_loadu_ps(f + 2 * j);
+                    _mm256_storeu_ps(f + 2 * j, _mm256_fmaddsub_ps(v, cr, _mm256_mul_ps(_mm256_permute_ps(v, 0xB1), ci)));
+                }
+                if (j < count)
+                    scalar::scale(__p + j, count - j, c);
+            }
+
+            SIMULATOR_AVX2 void scale_periodic(complex_f *__p, const std::size_t &count, const complex_f *__c)
+            {
+                __m256 cr[2], ci[2];
+                for (std::size_t l = 0; l < 2; l++)
+                {
+                    const complex_f *c = __c + 4 * l;
+                    cr[l] = _mm256_setr_ps(c[0].real(), c[0].real(), c[1].real(), c[1].real(), c[2].real(), c[2].real(), c[3].real(), c[3].real());
+                    ci[l] = _mm256_setr_ps(c[0].imag(), c[0].imag(), c[1].imag(), c[1].imag(), c[2].imag(), c[2].imag(), c[3].imag(), c[3].imag());
+                }
+                float *f = reinterpret_cast<float *>(__p);
+                std::size_t j = 0;
+                for (; j + 8 <= count; j += 8)
+                    for (std::size_t l = 0; l < 2; l++)
+                    {
+                        const __m256 v = _mm256_loadu_ps(f + 2 * j + 8 * l);
+                        _mm256_storeu_ps(f + 2 * j + 8 * l, _mm256_fmaddsub_ps(v, cr[l], _mm256_mul_ps(_mm256_permute_ps(v, 0xB1), ci[l])));
+                    }
+                if (j < count)
+                    scalar::scale_periodic(__p + j, count - j, __c);
+            }
+
+            template <std::size_t stride>
+            SIMULATOR_AVX2 static void apply_diagonal_low(complex_f *__s, const complex_f &d0, const complex_f &d1, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const __m256 cr = lanes_f<stride>(d0.real(), d1.real()), ci = lanes_f<stride>(d0.imag(), d1.imag());
+                float *f = reinterpret_cast<float *>(__s);
+                std::size_t p = _begin;
+                if (stride == 2 && p < _end && (p & 1))
+                {
+                    scalar::apply_diagonal(__s, d0, d1, stride, p, p + 1);
+                    p++;
+                }
+                for (; p + 2 <= _end; p += 2)
+                {
+                    float *q = f + 2 * pair_base(p, stride);
+                    const __m256 v = _mm256_loadu_ps(q);
+                    _mm256_storeu_ps(q, _mm256_fmaddsub_ps(v, cr, _mm256_mul_ps(_mm256_permute_ps(v, 0xB1), ci)));
+                }
+                if (p < _end)
+                    scalar::apply_diagonal(__s, d0, d1, stride, p, _end);
+            }
+
+            SIMULATOR_AVX2 void apply_diagonal(complex_f *__s, const complex_f &d0, const complex_f &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_diagonal_low<1>(__s, d0, d1, _begin, _end);
+                if (stride == 2)
+                    return apply_diagonal_low<2>(__s, d0, d1, _begin, _end);
+
+                const bool skip0 = d0.real() == 1.0f && d0.imag() == 0.0f;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    if (!skip0)
+                        scale(__s + i, run, d0);
+                    scale(__s + i + stride, run, d1);
+                    p += run;
+                }
+            }
+        }
+    }
+}
+
+#endif
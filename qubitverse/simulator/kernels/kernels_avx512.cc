@@ -0,0 +1,371 @@
+/**
+ * @file kernels_avx512.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./isa.hh"
+
+#if defined(SIMULATOR_KERNELS_X86)
+// GCC reports -Wmaybe-uninitialized inside avx512fintrin.h wherever an intrinsic is built on the undefined-register
+// forms (`_mm512_undefined_pd()` and friends as the pass-through operand of the unmasked builtins): those operands are
+// never read, the warnings are false positives, so they are silenced for this translation unit only
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+
+#define SIMULATOR_AVX512 SIMULATOR_TARGET("avx512f,avx2,fma")
+
+namespace simulator
+{
+    namespace kernels
+    {
+        namespace avx512
+        {
+            // same as `avx2::cmul2`, but for four complex numbers per register
+            SIMULATOR_AVX512 static inline __m512d cmul4(const __m512d &a, const __m512d &b, const __m512d &m0r, const __m512d &m0i, const __m512d &m1r, const __m512d &m1i)
+            {
+                __m512d t = _mm512_mul_pd(_mm512_permute_pd(a, 0x55), m0i);
+                t = _mm512_fmadd_pd(_mm512_permute_pd(b, 0x55), m1i, t);
+                const __m512d r = _mm512_fmaddsub_pd(a, m0r, t);
+                return _mm512_fmadd_pd(b, m1r, r);
+            }
+
+            // lane-varying coefficients for a register holding whole pairs: (c0, c1) repeated in the layout of the lane swap,
+            // amplitude-wise (c0, c1, c0, c1) for target 0 and (c0, c0, c1, c1) for target 1
+            template <std::size_t stride>
+            SIMULATOR_AVX512 static inline __m512d lanes(const double &c0, const double &c1)
+            {
+                if constexpr (stride == 1)
+                    return _mm512_setr_pd(c0, c0, c1, c1, c0, c0, c1, c1);
+                else
+                    return _mm512_setr_pd(c0, c0, c0, c0, c1, c1, c1, c1);
+            }
+
+            // brings every amplitude next to its partner: swaps neighbouring 128-bit lanes for target 0, 256-bit halves for target 1
+            template <std::size_t stride>
+            SIMULATOR_AVX512 static inline __m512d partner(const __m512d &v)
+            {
+                if constexpr (stride == 1)
+                    return _mm512_shuffle_f64x2(v, v, 0xB1);
+                else
+                    return _mm512_shuffle_f64x2(v, v, 0x4E);
+            }
+
+            // targets 0 and 1: one register holds two whole pairs, so the gate is one lane swap and one lane-varying multiply,
+            // with (m00, m11) on the diagonal and (m01, m10) across, no pair ever leaves the register
+            template <std::size_t stride>
+            SIMULATOR_AVX512 static void apply_2x2_low(complex *__s, const complex (&__m)[2][2], const std::size_t &_begin, const std::size_t &_end)
+            {
+                static_assert(stride == 1 || stride == 2, "only targets 0 and 1 have a low-stride kernel");
+                const __m512d dr = lanes<stride>(__m[0][0].real(), __m[1][1].real()), di = lanes<stride>(__m[0][0].imag(), __m[1][1].imag());
+                const __m512d xr = lanes<stride>(__m[0][1].real(), __m[1][0].real()), xi = lanes<stride>(__m[0][1].imag(), __m[1][0].imag());
+
+                double *d = reinterpret_cast<double *>(__s);
+                std::size_t p = _begin;
+                // target 1 registers start at even pairs
+                if (stride == 2 && p < _end && (p & 1))
+                {
+                    avx2::apply_2x2(__s, __m, stride, p, p + 1);
+                    p++;
+                }
+                for (; p + 2 <= _end; p += 2)
+                {
+                    double *q = d + 2 * pair_base(p, stride);
+                    const __m512d v = _mm512_loadu_pd(q);
+                    _mm512_storeu_pd(q, cmul4(v, partner<stride>(v), dr, di, xr, xi));
+                }
+                if (p < _end)
+                    avx2::apply_2x2(__s, __m, stride, p, _end);
+            }
+
+            SIMULATOR_AVX512 void apply_2x2(complex *__s, const complex (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_2x2_low<1>(__s, __m, _begin, _end);
+                if (stride == 2)
+                    return apply_2x2_low<2>(__s, __m, _begin, _end);
+
+                const __m512d m00r = _mm512_set1_pd(__m[0][0].real()), m00i = _mm512_set1_pd(__m[0][0].imag());
+                const __m512d m01r = _mm512_set1_pd(__m[0][1].real()), m01i = _mm512_set1_pd(__m[0][1].imag());
+                const __m512d m10r = _mm512_set1_pd(__m[1][0].real()), m10i = _mm512_set1_pd(__m[1][0].imag());
+                const __m512d m11r = _mm512_set1_pd(__m[1][1].real()), m11i = _mm512_set1_pd(__m[1][1].imag());
+
+                const bool prefetch = stride >= prefetch_min_stride<double>;
+                double *d = reinterpret_cast<double *>(__s);
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; j += 4)
+                    {
+                        double *p0 = d + 2 * j;
+                        double *p1 = d + 2 * (j + stride);
+                        if (prefetch)
+                        {
+                            _mm_prefetch(reinterpret_cast<const char *>(p0) + prefetch_ahead, _MM_HINT_T0);
+                            _mm_prefetch(reinterpret_cast<const char *>(p1) + prefetch_ahead, _MM_HINT_T0);
+                        }
+
+                        const __m512d a = _mm512_loadu_pd(p0);
+                        const __m512d b = _mm512_loadu_pd(p1);
+
+                        _mm512_storeu_pd(p0, cmul4(a, b, m00r, m00i, m01r, m01i));
+                        _mm512_storeu_pd(p1, cmul4(a, b, m10r, m10i, m11r, m11i));
+                    }
+                    p += run;
+                }
+            }
+
+            SIMULATOR_AVX512 void scale(complex *__p, const std::size_t &count, const complex &c)
+            {
+                const __m512d cr = _mm512_set1_pd(c.real()), ci = _mm512_set1_pd(c.imag());
+                double *d = reinterpret_cast<double *>(__p);
+                std::size_t j = 0;
+                for (; j + 4 <= count; j += 4)
+                {
+                    const __m512d v = _mm512_loadu_pd(d + 2 * j);
+                    _mm512_storeu_pd(d + 2 * j, _mm512_fmaddsub_pd(v, cr, _mm512_mul_pd(_mm512_permute_pd(v, 0x55), ci)));
+                }
+                if (j < count)
+                    avx2::scale(__p + j, count - j, c);
+            }
+
+            SIMULATOR_AVX512 void scale_periodic(complex *__p, const std::size_t &count, const complex *__c)
+            {
+                __m512d cr[2], ci[2];
+                for (std::size_t l = 0; l < 2; l++)
+                {
+                    const complex *c = __c + 4 * l;
+                    cr[l] = _mm512_setr_pd(c[0].real(), c[0].real(), c[1].real(), c[1].real(), c[2].real(), c[2].real(), c[3].real(), c[3].real());
+                    ci[l] = _mm512_setr_pd(c[0].imag(), c[0].imag(), c[1].imag(), c[1].imag(), c[2].imag(), c[2].imag(), c[3].imag(), c[3].imag());
+                }
+                double *d = reinterpret_cast<double *>(__p);
+                std::size_t j = 0;
+                for (; j + 8 <= count; j += 8)
+                    for (std::size_t l = 0; l < 2; l++)
+                    {
+                        const __m512d v = _mm512_loadu_pd(d + 2 * j + 8 * l);
+                        _mm512_storeu_pd(d + 2 * j + 8 * l, _mm512_fmaddsub_pd(v, cr[l], _mm512_mul_pd(_mm512_permute_pd(v, 0x55), ci[l])));
+                    }
+                if (j < count)
+                    avx2::scale_periodic(__p + j, count - j, __c);
+            }
+
+            template <std::size_t stride>
+            SIMULATOR_AVX512 static void apply_diagonal_low(complex *__s, const complex &d0, const complex &d1, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const __m512d cr = lanes<stride>(d0.real(), d1.real()), ci = lanes<stride>(d0.imag(), d1.imag());
+                double *d = reinterpret_cast<double *>(__s);
+                std::size_t p = _begin;
+                if (stride == 2 && p < _end && (p & 1))
+                {
+                    avx2::apply_diagonal(__s, d0, d1, stride, p, p + 1);
+                    p++;
+                }
+                for (; p + 2 <= _end; p += 2)
+                {
+                    double *q = d + 2 * pair_base(p, stride);
+                    const __m512d v = _mm512_loadu_pd(q);
+                    _mm512_storeu_pd(q, _mm512_fmaddsub_pd(v, cr, _mm512_mul_pd(_mm512_permute_pd(v, 0x55), ci)));
+                }
+                if (p < _end)
+                    avx2::apply_diagonal(__s, d0, d1, stride, p, _end);
+            }
+
+            SIMULATOR_AVX512 void apply_diagonal(complex *__s, const complex &d0, const complex &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_diagonal_low<1>(__s, d0, d1, _begin, _end);
+                if (stride == 2)
+                    return apply_diagonal_low<2>(__s, d0, d1, _begin, _end);
+
+                const bool skip0 = d0.real() == 1.0 && d0.imag() == 0.0;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    if (!skip0)
+                        scale(__s + i, run, d0);
+                    scale(__s + i + stride, run, d1);
+                    p += run;
+                }
+            }
+
+            SIMULATOR_AVX512 void swap_pairs(complex *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                double *d = reinterpret_cast<double *>(__s);
+                std::size_t p = _begin;
+                if (stride == 1)
+                {
+                    // two pairs per register: swap neighbouring 128-bit lanes
+                    for (; p + 2 <= _end; p += 2)
+                        _mm512_storeu_pd(d + 4 * p, _mm512_shuffle_f64x2(_mm512_loadu_pd(d + 4 * p), _mm512_loadu_pd(d + 4 * p), 0xB1));
+                    return avx2::swap_pairs(__s, stride, p, _end);
+                }
+                if (stride == 2)
+                {
+                    // one register holds both halves of two pairs: swap its 256-bit halves
+                    for (; p + 2 <= _end && (p & 1) == 0; p += 2)
+                    {
+                        double *q = d + 2 * pair_base(p, stride);
+                        _mm512_storeu_pd(q, _mm512_shuffle_f64x2(_mm512_loadu_pd(q), _mm512_loadu_pd(q), 0x4E));
+                    }
+                    return avx2::swap_pairs(__s, stride, p, _end);
+                }
+
+                while (p < _end)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    std::size_t j = i;
+                    for (; j + 4 <= i + run; j += 4)
+                    {
+                        const __m512d a = _mm512_loadu_pd(d + 2 * j);
+                        const __m512d b = _mm512_loadu_pd(d + 2 * (j + stride));
+                        _mm512_storeu_pd(d + 2 * j, b);
+                        _mm512_storeu_pd(d + 2 * (j + stride), a);
+                    }
+                    if (j < i + run)
+                        avx2::swap_pairs(__s, stride, p + (j - i), p + run);
+                    p += run;
+                }
+            }
+
+            // groups whose bases are contiguous (below the block's lowest qubit) are processed 4 at a time, one lane per group
+            SIMULATOR_AVX512 void apply_dense(complex *__s, const dense_plan<double> &__p, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (__p.M_strides[0] < 4)
+                    return avx2::apply_dense(__s, __p, _begin, _end);
+
+                const std::size_t dim = __p.M_dim;
+                const double *u = reinterpret_cast<const double *>(__p.M_matrix);
+                double *d = reinterpret_cast<double *>(__s);
+                __m512d v[1ULL << max_dense_qubits];
+
+                for (std::size_t k = _begin; k < _end;)
+                {
+                    const std::size_t base = dense_base(k, __p), run = pair_run(k, __p.M_strides[0], _end);
+                    std::size_t j = 0;
+                    for (; j + 4 <= run; j += 4)
+                    {
+                        for (std::size_t c = 0; c < dim; c++)
+                            v[c] = _mm512_loadu_pd(d + 2 * (base + j + __p.M_offsets[c]));
+                        for (std::size_t r = 0; r < dim; r++)
+                        {
+                            const double *row = u + 2 * r * dim;
+                            __m512d re = _mm512_setzero_pd(), im = _mm512_setzero_pd();
+                            for (std::size_t c = 0; c < dim; c++)
+                            {
+                                re = _mm512_fmadd_pd(v[c], _mm512_set1_pd(row[2 * c]), re);
+                                im = _mm512_fmadd_pd(_mm512_permute_pd(v[c], 0x55), _mm512_set1_pd(row[2 * c + 1]), im);
+                            }
+                            _mm512_storeu_pd(d + 2 * (base + j + __p.M_offsets[r]), _mm512_fmaddsub_pd(re, _mm512_set1_pd(1.0), im));
+                        }
+                    }
+                    if (j < run)
+                        scalar::apply_dense(__s, __p, k + j, k + run);
+                    k += run;
+                }
+            }
+
+            // single precision: eight complex numbers per register, targets below 3 are left to the AVX2 variant
+            SIMULATOR_AVX512 static inline __m512 cmul8f(const __m512 &a, const __m512 &b, const __m512 &m0r, const __m512 &m0i, const __m512 &m1r, const __m512 &m1i)
+            {
+                __m512 t = _mm512_mul_ps(_mm512_permute_ps(a, 0xB1), m0i);
+                t = _mm512_fmadd_ps(_mm512_permute_ps(b, 0xB1), m1i, t);
+                const __m512 r = _mm512_fmaddsub_ps(a, m0r, t);
+                return _mm512_fmadd_ps(b, m1r, r);
+            }
+
+            SIMULATOR_AVX512 void apply_2x2(complex_f *__s, const complex_f (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride < 8)
+                    return avx2::apply_2x2(__s, __m, stride, _begin, _end);
+
+                const __m512 m00r = _mm512_set1_ps(__m[0][0].real()), m00i = _mm512_set1_ps(__m[0][0].imag());
+                const __m512 m01r = _mm512_set1_ps(__m[0][1].real()), m01i = _mm512_set1_ps(__m[0][1].imag());
+                const __m512 m10r = _mm512_set1_ps(__m[1][0].real()), m10i = _mm512_set1_ps(__m[1][0].imag());
+                const __m512 m11r = _mm512_set1_ps(__m[1][1].real()), m11i = _mm512_set1_ps(__m[1][1].imag());
+
+                const bool prefetch = stride >= prefetch_min_stride<float>;
+                float *f = reinterpret_cast<float *>(__s);
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; j += 8)
+                    {
+                        float *p0 = f + 2 * j;
+                        float *p1 = f + 2 * (j + stride);
+                        if (prefetch)
+                        {
+                            _mm_prefetch(reinterpret_cast<const char *>(p0) + prefetch_ahead, _MM_HINT_T0);
+                            _mm_prefetch(reinterpret_cast<const char *>(p1) + prefetch_ahead, _MM_HINT_T0);
+                        }
+
+                        const __m512 a = _mm512_loadu_ps(p0);
+                        const __m512 b = _mm512_loadu_ps(p1);
+
+                        _mm512_storeu_ps(p0, cmul8f(a, b, m00r, m00i, m01r, m01i));
+                        _mm512_storeu_ps(p1, cmul8f(a, b, m10r, m10i, m11r, m11i));
+                    }
+                    p += run;
+                }
+            }
+
+            SIMULATOR_AVX512 void scale(complex_f *__p, const std::size_t &count, const complex_f &c)
+            {
+                const __m512 cr = _mm512_set1_ps(c.real()), ci = _mm512_set1_ps(c.imag());
+                float *f = reinterpret_cast<float *>(__p);
+                std::size_t j = 0;
+                for (; j + 8 <= count; j += 8)
+                {
+                    const __m512 v = _mm512_loadu_ps(f + 2 * j);
+                    _mm512_storeu_ps(f + 2 * j, _mm512_fmaddsub_ps(v, cr, _mm512_mul_ps(_mm512_permute_ps(v, 0xB1), ci)));
+                }
+                if (j < count)
+                    avx2::scale(__p + j, count - j, c);
+            }
+
+            SIMULATOR_AVX512 void scale_periodic(complex_f *__p, const std::size_t &count, const complex_f *__c)
+            {
+                float re[16], im[16];
+                for (std::size_t l = 0; l < 8; l++)
+                {
+                    re[2 * l] = re[2 * l + 1] = __c[l].real();
+                    im[2 * l] = im[2 * l + 1] = __c[l].imag();
+                }
+                const __m512 cr = _mm512_loadu_ps(re), ci = _mm512_loadu_ps(im);
+                float *f = reinterpret_cast<float *>(__p);
+                std::size_t j = 0;
+                for (; j + 8 <= count; j += 8)
+                {
+                    const __m512 v = _mm512_loadu_ps(f + 2 * j);
+                    _mm512_storeu_ps(f + 2 * j, _mm512_fmaddsub_ps(v, cr, _mm512_mul_ps(_mm512_permute_ps(v, 0xB1), ci)));
+                }
+                if (j < count)
+                    avx2::scale_periodic(__p + j, count - j, __c);
+            }
+
+            SIMULATOR_AVX512 void apply_diagonal(complex_f *__s, const complex_f &d0, const complex_f &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride < 8)
+                    return avx2::apply_diagonal(__s, d0, d1, stride, _begin, _end);
+
+                const bool skip0 = d0.real() == 1.0f && d0.imag() == 0.0f;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    if (!skip0)
+                        scale(__s + i, run, d0);
+                    scale(__s + i + stride, run, d1);
+                    p += run;
+                }
+            }
+        }
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
@@ -0,0 +1,230 @@
+/**
+ * @file kernels_scalar.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./isa.hh"
+#include <algorithm>
+
+namespace simulator
+{
+    namespace kernels
+    {
+        namespace scalar
+        {
+            // `std::complex<T>` is layout compatible with `T[2]`, every variant works on the raw scalars, and is instantiated for
+            // double and float at the bottom of this file
+
+            // (m00 * a + m01 * b, m10 * a + m11 * b) in place, `m` holds the matrix as real/imaginary parts row by row
+            template <typename T>
+            static inline void mix_pair(T *p0, T *p1, const T (&m)[8])
+            {
+                const T ar = p0[0], ai = p0[1];
+                const T br = p1[0], bi = p1[1];
+
+                p0[0] = m[0] * ar - m[1] * ai + m[2] * br - m[3] * bi;
+                p0[1] = m[0] * ai + m[1] * ar + m[2] * bi + m[3] * br;
+                p1[0] = m[4] * ar - m[5] * ai + m[6] * br - m[7] * bi;
+                p1[1] = m[4] * ai + m[5] * ar + m[6] * bi + m[7] * br;
+            }
+
+            // targets 0 and 1: every run is only 1-2 pairs long, with the stride known at compile time the pair index folds into
+            // a shift and mask and the run bookkeeping disappears
+            template <typename T, std::size_t stride>
+            static void apply_2x2_low(T *d, const T (&m)[8], const std::size_t &_begin, const std::size_t &_end)
+            {
+                for (std::size_t p = _begin; p < _end; p++)
+                {
+                    const std::size_t j = pair_base(p, stride);
+                    mix_pair(d + 2 * j, d + 2 * (j + stride), m);
+                }
+            }
+
+            template <typename T>
+            void apply_2x2(std::complex<T> *__s, const std::complex<T> (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                // keep the matrix in locals, so that it is not re-read from memory inside the loop
+                const T m[8] = {__m[0][0].real(), __m[0][0].imag(), __m[0][1].real(), __m[0][1].imag(),
+                                __m[1][0].real(), __m[1][0].imag(), __m[1][1].real(), __m[1][1].imag()};
+
+                T *d = reinterpret_cast<T *>(__s);
+                if (stride == 1)
+                    return apply_2x2_low<T, 1>(d, m, _begin, _end);
+                if (stride == 2)
+                    return apply_2x2_low<T, 2>(d, m, _begin, _end);
+
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; ++j)
+                        mix_pair(d + 2 * j, d + 2 * (j + stride), m);
+                    p += run;
+                }
+            }
+
+            // calls `fn(base, run)` for every run of contiguous quarter bases in [_begin, _end), `q1`/`q2` are 2^qubit in any order
+            template <typename FUNC>
+            static inline void for_each_quarter(const std::size_t &q1, const std::size_t &q2, const std::size_t &_begin, const std::size_t &_end, FUNC &&fn)
+            {
+                const std::size_t lo = q1 < q2 ? q1 : q2, hi = q1 < q2 ? q2 : q1;
+                for (std::size_t k = _begin; k < _end;)
+                {
+                    const std::size_t run = pair_run(k, lo, _end);
+                    fn(quarter_base(k, lo, hi), run);
+                    k += run;
+                }
+            }
+
+            template <typename T>
+            void apply_cnot(std::complex<T> *__s, const std::size_t &control, const std::size_t &target, const std::size_t &_begin, const std::size_t &_end)
+            {
+                // only the control=1 half moves: |10> <-> |11>
+                for_each_quarter(control, target, _begin, _end, [&](const std::size_t &base, const std::size_t &run)
+                                 { std::swap_ranges(__s + (base | control), __s + (base | control) + run, __s + (base | control | target)); });
+            }
+
+            template <typename T>
+            void apply_cz(std::complex<T> *__s, const std::size_t &control, const std::size_t &target, const std::size_t &_begin, const std::size_t &_end)
+            {
+                // only the |11> quarter picks up the phase
+                for_each_quarter(control, target, _begin, _end, [&](const std::size_t &base, const std::size_t &run)
+                                 {
+                    std::complex<T> *p = __s + (base | control | target);
+                    for (std::size_t j = 0; j < run; j++)
+                        p[j] = -p[j]; });
+            }
+
+            template <typename T>
+            void apply_swap(std::complex<T> *__s, const std::size_t &q1, const std::size_t &q2, const std::size_t &_begin, const std::size_t &_end)
+            {
+                // only |01> <-> |10> move
+                for_each_quarter(q1, q2, _begin, _end, [&](const std::size_t &base, const std::size_t &run)
+                                 { std::swap_ranges(__s + (base | q1), __s + (base | q1) + run, __s + (base | q2)); });
+            }
+
+            template <typename T>
+            void scale(std::complex<T> *__p, const std::size_t &count, const std::complex<T> &c)
+            {
+                const T cr = c.real(), ci = c.imag();
+                T *d = reinterpret_cast<T *>(__p);
+                for (std::size_t j = 0; j < count; j++)
+                {
+                    const T re = d[2 * j], im = d[2 * j + 1];
+                    d[2 * j] = re * cr - im * ci;
+                    d[2 * j + 1] = re * ci + im * cr;
+                }
+            }
+
+            template <typename T>
+            void scale_periodic(std::complex<T> *__p, const std::size_t &count, const std::complex<T> *__c)
+            {
+                T cr[8], ci[8];
+                for (std::size_t l = 0; l < 8; l++)
+                {
+                    cr[l] = __c[l].real();
+                    ci[l] = __c[l].imag();
+                }
+                T *d = reinterpret_cast<T *>(__p);
+                for (std::size_t j = 0; j < count; j++)
+                {
+                    const T re = d[2 * j], im = d[2 * j + 1];
+                    d[2 * j] = re * cr[j & 7] - im * ci[j & 7];
+                    d[2 * j + 1] = re * ci[j & 7] + im * cr[j & 7];
+                }
+            }
+
+            template <typename T, std::size_t stride>
+            static void apply_diagonal_low(T *d, const std::complex<T> &d0, const std::complex<T> &d1, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const T d0r = d0.real(), d0i = d0.imag(), d1r = d1.real(), d1i = d1.imag();
+                for (std::size_t p = _begin; p < _end; p++)
+                {
+                    T *p0 = d + 2 * pair_base(p, stride), *p1 = p0 + 2 * stride;
+                    const T ar = p0[0], ai = p0[1], br = p1[0], bi = p1[1];
+                    p0[0] = ar * d0r - ai * d0i;
+                    p0[1] = ar * d0i + ai * d0r;
+                    p1[0] = br * d1r - bi * d1i;
+                    p1[1] = br * d1i + bi * d1r;
+                }
+            }
+
+            template <typename T>
+            void apply_diagonal(std::complex<T> *__s, const std::complex<T> &d0, const std::complex<T> &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_diagonal_low<T, 1>(reinterpret_cast<T *>(__s), d0, d1, _begin, _end);
+                if (stride == 2)
+                    return apply_diagonal_low<T, 2>(reinterpret_cast<T *>(__s), d0, d1, _begin, _end);
+
+                const bool skip0 = d0.real() == T(1) && d0.imag() == T(0);
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    if (!skip0)
+                        scale(__s + i, run, d0);
+                    scale(__s + i + stride, run, d1);
+                    p += run;
+                }
+            }
+
+            template <typename T>
+            void swap_pairs(std::complex<T> *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    std::swap_ranges(__s + i, __s + i + run, __s + i + stride);
+                    p += run;
+                }
+            }
+
+            template <typename T>
+            void apply_dense(std::complex<T> *__s, const dense_plan<T> &__p, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const std::size_t dim = __p.M_dim;
+                const T *u = reinterpret_cast<const T *>(__p.M_matrix);
+                T *d = reinterpret_cast<T *>(__s);
+                T v[2ULL << max_dense_qubits];
+
+                for (std::size_t k = _begin; k < _end; k++)
+                {
+                    const std::size_t base = dense_base(k, __p);
+                    for (std::size_t c = 0; c < dim; c++)
+                    {
+                        v[2 * c] = d[2 * (base + __p.M_offsets[c])];
+                        v[2 * c + 1] = d[2 * (base + __p.M_offsets[c]) + 1];
+                    }
+                    for (std::size_t r = 0; r < dim; r++)
+                    {
+                        const T *row = u + 2 * r * dim;
+                        T re = 0, im = 0;
+                        for (std::size_t c = 0; c < dim; c++)
+                        {
+                            re += row[2 * c] * v[2 * c] - row[2 * c + 1] * v[2 * c + 1];
+                            im += row[2 * c] * v[2 * c + 1] + row[2 * c + 1] * v[2 * c];
+                        }
+                        d[2 * (base + __p.M_offsets[r])] = re;
+                        d[2 * (base + __p.M_offsets[r]) + 1] = im;
+                    }
+                }
+            }
+
+#define SIMULATOR_SCALAR_INSTANTIATE(T)                                                                                                                                  \
+    template void apply_2x2<T>(std::complex<T> *, const std::complex<T>(&)[2][2], const std::size_t &, const std::size_t &, const std::size_t &);                        \
+    template void apply_cnot<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &, const std::size_t &);                                  \
+    template void apply_cz<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &, const std::size_t &);                                    \
+    template void apply_swap<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &, const std::size_t &);                                  \
+    template void scale<T>(std::complex<T> *, const std::size_t &, const std::complex<T> &);                                                                             \
+    template void scale_periodic<T>(std::complex<T> *, const std::size_t &, const std::complex<T> *);                                                                    \
+    template void apply_diagonal<T>(std::complex<T> *, const std::complex<T> &, const std::complex<T> &, const std::size_t &, const std::size_t &, const std::size_t &); \
+    template void swap_pairs<T>(std::complex<T> *, const std::size_t &, const std::size_t &, const std::size_t &);                                                       \
+    template void apply_dense<T>(std::complex<T> *, const dense_plan<T> &, const std::size_t &, const std::size_t &);
+
+            SIMULATOR_SCALAR_INSTANTIATE(double)
+            SIMULATOR_SCALAR_INSTANTIATE(float)
+
+#undef SIMULATOR_SCALAR_INSTANTIATE
+        }
+    }
+}
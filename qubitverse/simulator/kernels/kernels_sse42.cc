@@ -0,0 +1,304 @@
+/**
+ * @file kernels_sse42.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./isa.hh"
+
+#if defined(SIMULATOR_KERNELS_X86)
+#include <immintrin.h>
+
+#define SIMULATOR_SSE42 SIMULATOR_TARGET("sse4.2")
+
+namespace simulator
+{
+    namespace kernels
+    {
+        namespace sse42
+        {
+            // (__m0 * a) + (__m1 * b) for one complex number per register, __m0/__m1 are split in broadcast real and imaginary parts
+            SIMULATOR_SSE42 static inline __m128d cmul1(const __m128d &a, const __m128d &b, const __m128d &m0r, const __m128d &m0i, const __m128d &m1r, const __m128d &m1i)
+            {
+                const __m128d t = _mm_add_pd(_mm_mul_pd(_mm_shuffle_pd(a, a, 0x1), m0i), _mm_mul_pd(_mm_shuffle_pd(b, b, 0x1), m1i));
+                return _mm_addsub_pd(_mm_add_pd(_mm_mul_pd(a, m0r), _mm_mul_pd(b, m1r)), t);
+            }
+
+            // targets 0 and 1: with the stride known at compile time the pair index folds into a shift and mask, so the 1-2
+            // pair runs no longer pay for the run bookkeeping
+            template <std::size_t stride>
+            SIMULATOR_SSE42 static void apply_2x2_low(double *d, const __m128d (&m)[8], const std::size_t &_begin, const std::size_t &_end)
+            {
+                for (std::size_t p = _begin; p < _end; p++)
+                {
+                    double *p0 = d + 2 * pair_base(p, stride);
+                    double *p1 = p0 + 2 * stride;
+
+                    const __m128d a = _mm_loadu_pd(p0);
+                    const __m128d b = _mm_loadu_pd(p1);
+
+                    _mm_storeu_pd(p0, cmul1(a, b, m[0], m[1], m[2], m[3]));
+                    _mm_storeu_pd(p1, cmul1(a, b, m[4], m[5], m[6], m[7]));
+                }
+            }
+
+            SIMULATOR_SSE42 void apply_2x2(complex *__s, const complex (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const __m128d m[8] = {_mm_set1_pd(__m[0][0].real()), _mm_set1_pd(__m[0][0].imag()), _mm_set1_pd(__m[0][1].real()), _mm_set1_pd(__m[0][1].imag()),
+                                      _mm_set1_pd(__m[1][0].real()), _mm_set1_pd(__m[1][0].imag()), _mm_set1_pd(__m[1][1].real()), _mm_set1_pd(__m[1][1].imag())};
+
+                double *d = reinterpret_cast<double *>(__s);
+                if (stride == 1)
+                    return apply_2x2_low<1>(d, m, _begin, _end);
+                if (stride == 2)
+                    return apply_2x2_low<2>(d, m, _begin, _end);
+
+                const bool prefetch = stride >= prefetch_min_stride<double>;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; ++j)
+                    {
+                        double *p0 = d + 2 * j;
+                        double *p1 = d + 2 * (j + stride);
+                        if (prefetch)
+                        {
+                            _mm_prefetch(reinterpret_cast<const char *>(p0) + prefetch_ahead, _MM_HINT_T0);
+                            _mm_prefetch(reinterpret_cast<const char *>(p1) + prefetch_ahead, _MM_HINT_T0);
+                        }
+
+                        const __m128d a = _mm_loadu_pd(p0);
+                        const __m128d b = _mm_loadu_pd(p1);
+
+                        _mm_storeu_pd(p0, cmul1(a, b, m[0], m[1], m[2], m[3]));
+                        _mm_storeu_pd(p1, cmul1(a, b, m[4], m[5], m[6], m[7]));
+                    }
+                    p += run;
+                }
+            }
+
+            SIMULATOR_SSE42 void scale(complex *__p, const std::size_t &count, const complex &c)
+            {
+                const __m128d cr = _mm_set1_pd(c.real()), ci = _mm_set1_pd(c.imag());
+                double *d = reinterpret_cast<double *>(__p);
+                for (std::size_t j = 0; j < count; j++)
+                {
+                    const __m128d v = _mm_loadu_pd(d + 2 * j);
+                    _mm_storeu_pd(d + 2 * j, _mm_addsub_pd(_mm_mul_pd(v, cr), _mm_mul_pd(_mm_shuffle_pd(v, v, 0x1), ci)));
+                }
+            }
+
+            SIMULATOR_SSE42 void scale_periodic(complex *__p, const std::size_t &count, const complex *__c)
+            {
+                __m128d cr[8], ci[8];
+                for (std::size_t l = 0; l < 8; l++)
+                {
+                    cr[l] = _mm_set1_pd(__c[l].real());
+                    ci[l] = _mm_set1_pd(__c[l].imag());
+                }
+                double *d = reinterpret_cast<double *>(__p);
+                std::size_t j = 0;
+                for (; j + 8 <= count; j += 8)
+                    for (std::size_t l = 0; l < 8; l++)
+                    {
+                        const __m128d v = _mm_loadu_pd(d + 2 * (j + l));
+                        _mm_storeu_pd(d + 2 * (j + l), _mm_addsub_pd(_mm_mul_pd(v, cr[l]), _mm_mul_pd(_mm_shuffle_pd(v, v, 0x1), ci[l])));
+                    }
+                if (j < count)
+                    scalar::scale_periodic(__p + j, count - j, __c);
+            }
+
+            template <std::size_t stride>
+            SIMULATOR_SSE42 static void apply_diagonal_low(double *d, const complex &d0, const complex &d1, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const __m128d d0r = _mm_set1_pd(d0.real()), d0i = _mm_set1_pd(d0.imag());
+                const __m128d d1r = _mm_set1_pd(d1.real()), d1i = _mm_set1_pd(d1.imag());
+                for (std::size_t p = _begin; p < _end; p++)
+                {
+                    double *p0 = d + 2 * pair_base(p, stride), *p1 = p0 + 2 * stride;
+                    const __m128d a = _mm_loadu_pd(p0), b = _mm_loadu_pd(p1);
+                    _mm_storeu_pd(p0, _mm_addsub_pd(_mm_mul_pd(a, d0r), _mm_mul_pd(_mm_shuffle_pd(a, a, 0x1), d0i)));
+                    _mm_storeu_pd(p1, _mm_addsub_pd(_mm_mul_pd(b, d1r), _mm_mul_pd(_mm_shuffle_pd(b, b, 0x1), d1i)));
+                }
+            }
+
+            SIMULATOR_SSE42 void apply_diagonal(complex *__s, const complex &d0, const complex &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                    return apply_diagonal_low<1>(reinterpret_cast<double *>(__s), d0, d1, _begin, _end);
+                if (stride == 2)
+                    return apply_diagonal_low<2>(reinterpret_cast<double *>(__s), d0, d1, _begin, _end);
+
+                const bool skip0 = d0.real() == 1.0 && d0.imag() == 0.0;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    if (!skip0)
+                        scale(__s + i, run, d0);
+                    scale(__s + i + stride, run, d1);
+                    p += run;
+                }
+            }
+
+            SIMULATOR_SSE42 void swap_pairs(complex *__s, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                double *d = reinterpret_cast<double *>(__s);
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; j++)
+                    {
+                        const __m128d a = _mm_loadu_pd(d + 2 * j);
+                        const __m128d b = _mm_loadu_pd(d + 2 * (j + stride));
+                        _mm_storeu_pd(d + 2 * j, b);
+                        _mm_storeu_pd(d + 2 * (j + stride), a);
+                    }
+                    p += run;
+                }
+            }
+
+            // one register holds one complex amplitude, so every group is handled on its own
+            SIMULATOR_SSE42 void apply_dense(complex *__s, const dense_plan<double> &__p, const std::size_t &_begin, const std::size_t &_end)
+            {
+                const std::size_t dim = __p.M_dim;
+                const double *u = reinterpret_cast<const double *>(__p.M_matrix);
+                double *d = reinterpret_cast<double *>(__s);
+                __m128d v[1ULL << max_dense_qubits];
+
+                for (std::size_t k = _begin; k < _end; k++)
+                {
+                    const std::size_t base = dense_base(k, __p);
+                    for (std::size_t c = 0; c < dim; c++)
+                        v[c] = _mm_loadu_pd(d + 2 * (base + __p.M_offsets[c]));
+                    for (std::size_t r = 0; r < dim; r++)
+                    {
+                        const double *row = u + 2 * r * dim;
+                        __m128d re = _mm_setzero_pd(), im = _mm_setzero_pd();
+                        for (std::size_t c = 0; c < dim; c++)
+                        {
+                            re = _mm_add_pd(re, _mm_mul_pd(v[c], _mm_set1_pd(row[2 * c])));
+                            im = _mm_add_pd(im, _mm_mul_pd(_mm_shuffle_pd(v[c], v[c], 0x1), _mm_set1_pd(row[2 * c + 1])));
+                        }
+                        _mm_storeu_pd(d + 2 * (base + __p.M_offsets[r]), _mm_addsub_pd(re, im));
+                    }
+                }
+            }
+
+            // single precision: two complex numbers per register, same arithmetic as `cmul1` with the float shuffles
+            SIMULATOR_SSE42 static inline __m128 cmul2f(const __m128 &a, const __m128 &b, const __m128 &m0r, const __m128 &m0i, const __m128 &m1r, const __m128 &m1i)
+            {
+                const __m128 t = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, 0xB1), m0i), _mm_mul_ps(_mm_shuffle_ps(b, b, 0xB1), m1i));
+                return _mm_addsub_ps(_mm_add_ps(_mm_mul_ps(a, m0r), _mm_mul_ps(b, m1r)), t);
+            }
+
+            SIMULATOR_SSE42 void apply_2x2(complex_f *__s, const complex_f (&__m)[2][2], const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                float *f = reinterpret_cast<float *>(__s);
+                if (stride == 1)
+                {
+                    // one register is one whole pair, (m00, m11) on the diagonal and (m01, m10) across the swapped halves
+                    const __m128 dr = _mm_setr_ps(__m[0][0].real(), __m[0][0].real(), __m[1][1].real(), __m[1][1].real());
+                    const __m128 di = _mm_setr_ps(__m[0][0].imag(), __m[0][0].imag(), __m[1][1].imag(), __m[1][1].imag());
+                    const __m128 xr = _mm_setr_ps(__m[0][1].real(), __m[0][1].real(), __m[1][0].real(), __m[1][0].real());
+                    const __m128 xi = _mm_setr_ps(__m[0][1].imag(), __m[0][1].imag(), __m[1][0].imag(), __m[1][0].imag());
+                    for (std::size_t p = _begin; p < _end; p++)
+                    {
+                        const __m128 v = _mm_loadu_ps(f + 4 * p);
+                        _mm_storeu_ps(f + 4 * p, cmul2f(v, _mm_shuffle_ps(v, v, 0x4E), dr, di, xr, xi));
+                    }
+                    return;
+                }
+
+                const __m128 m00r = _mm_set1_ps(__m[0][0].real()), m00i = _mm_set1_ps(__m[0][0].imag());
+                const __m128 m01r = _mm_set1_ps(__m[0][1].real()), m01i = _mm_set1_ps(__m[0][1].imag());
+                const __m128 m10r = _mm_set1_ps(__m[1][0].real()), m10i = _mm_set1_ps(__m[1][0].imag());
+                const __m128 m11r = _mm_set1_ps(__m[1][1].real()), m11i = _mm_set1_ps(__m[1][1].imag());
+
+                const bool prefetch = stride >= prefetch_min_stride<float>;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    for (std::size_t j = i; j < i + run; j += 2)
+                    {
+                        float *p0 = f + 2 * j;
+                        float *p1 = f + 2 * (j + stride);
+                        if (prefetch)
+                        {
+                            _mm_prefetch(reinterpret_cast<const char *>(p0) + prefetch_ahead, _MM_HINT_T0);
+                            _mm_prefetch(reinterpret_cast<const char *>(p1) + prefetch_ahead, _MM_HINT_T0);
+                        }
+
+                        const __m128 a = _mm_loadu_ps(p0);
+                        const __m128 b = _mm_loadu_ps(p1);
+
+                        _mm_storeu_ps(p0, cmul2f(a, b, m00r, m00i, m01r, m01i));
+                        _mm_storeu_ps(p1, cmul2f(a, b, m10r, m10i, m11r, m11i));
+                    }
+                    p += run;
+                }
+            }
+
+            SIMULATOR_SSE42 void scale(complex_f *__p, const std::size_t &count, const complex_f &c)
+            {
+                const __m128 cr = _mm_set1_ps(c.real()), ci = _mm_set1_ps(c.imag());
+                float *f = reinterpret_cast<float *>(__p);
+                std::size_t j = 0;
+                for (; j + 2 <= count; j += 2)
+                {
+                    const __m128 v = _mm_loadu_ps(f + 2 * j);
+                    _mm_storeu_ps(f + 2 * j, _mm_addsub_ps(_mm_mul_ps(v, cr), _mm_mul_ps(_mm_shuffle_ps(v, v, 0xB1), ci)));
+                }
+                if (j < count)
+                    scalar::scale(__p + j, count - j, c);
+            }
+
+            SIMULATOR_SSE42 void scale_periodic(complex_f *__p, const std::size_t &count, const complex_f *__c)
+            {
+                __m128 cr[4], ci[4];
+                for (std::size_t l = 0; l < 4; l++)
+                {
+                    cr[l] = _mm_setr_ps(__c[2 * l].real(), __c[2 * l].real(), __c[2 * l + 1].real(), __c[2 * l + 1].real());
+                    ci[l] = _mm_setr_ps(__c[2 * l].imag(), __c[2 * l].imag(), __c[2 * l + 1].imag(), __c[2 * l + 1].imag());
+                }
+                float *f = reinterpret_cast<float *>(__p);
+                std::size_t j = 0;
+                for (; j + 8 <= count; j += 8)
+                    for (std::size_t l = 0; l < 4; l++)
+                    {
+                        const __m128 v = _mm_loadu_ps(f + 2 * j + 4 * l);
+                        _mm_storeu_ps(f + 2 * j + 4 * l, _mm_addsub_ps(_mm_mul_ps(v, cr[l]), _mm_mul_ps(_mm_shuffle_ps(v, v, 0xB1), ci[l])));
+                    }
+                if (j < count)
+                    scalar::scale_periodic(__p + j, count - j, __c);
+            }
+
+            SIMULATOR_SSE42 void apply_diagonal(complex_f *__s, const complex_f &d0, const complex_f &d1, const std::size_t &stride, const std::size_t &_begin, const std::size_t &_end)
+            {
+                if (stride == 1)
+                {
+                    const __m128 cr = _mm_setr_ps(d0.real(), d0.real(), d1.real(), d1.real());
+                    const __m128 ci = _mm_setr_ps(d0.imag(), d0.imag(), d1.imag(), d1.imag());
+                    float *f = reinterpret_cast<float *>(__s);
+                    for (std::size_t p = _begin; p < _end; p++)
+                    {
+                        const __m128 v = _mm_loadu_ps(f + 4 * p);
+                        _mm_storeu_ps(f + 4 * p, _mm_addsub_ps(_mm_mul_ps(v, cr), _mm_mul_ps(_mm_shuffle_ps(v, v, 0xB1), ci)));
+                    }
+                    return;
+                }
+
+                const bool skip0 = d0.real() == 1.0f && d0.imag() == 0.0f;
+                for (std::size_t p = _begin; p < _end;)
+                {
+                    const std::size_t i = pair_base(p, stride), run = pair_run(p, stride, _end);
+                    if (!skip0)
+                        scale(__s + i, run, d0);
+                    scale(__s + i + stride, run, d1);
+                    p += run;
+                }
+            }
+        }
+    }
+}
+
+#endif
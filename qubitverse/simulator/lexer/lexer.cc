@@ -56,6 +56,19 @@ namespace simulator
                         temp.append(&c, 1);
                         this->advance(c, i, __s);
                     }
+                    // an exponent (1e-6, 2.5E+3) belongs to the number, only when digits follow it
+                    const std::size_t sign = i + 1 < __s.length() && (__s[i + 1] == '-' || __s[i + 1] == '+') ? 1 : 0;
+                    if ((c == 'e' || c == 'E') && i + 1 + sign < __s.length() && std::isdigit(__s[i + 1 + sign]))
+                    {
+                        temp.append(__s, i, 1 + sign);
+                        i += sign;
+                        this->advance(c, i, __s);
+                        while (std::isdigit(c))
+                        {
+                            temp.append(&c, 1);
+                            this->advance(c, i, __s);
+                        }
+                    }
                     this->M_data.emplace_back(token_type::IDEN, std::move(temp));
                 }
                 else
@@ -0,0 +1,91 @@
+/**
+ * @file allocator.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./allocator.hh"
+#include "../threading/thread_pool.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#if defined(__unix__)
+#include <sys/mman.h>
+#endif
+
+namespace simulator
+{
+    // rounds `bytes` up to a multiple of `unit` (a power of 2)
+    static inline std::size_t round_up(const std::size_t &bytes, const std::size_t &unit)
+    {
+        return (bytes + unit - 1) & ~(unit - 1);
+    }
+
+    void *allocator::allocate(const std::size_t &bytes)
+    {
+#if defined(__unix__) && defined(MAP_ANONYMOUS)
+        if (bytes >= huge_page)
+        {
+            // mmap only promises 4 KiB alignment: over-map by one huge page and trim both ends to the 2 MiB boundary
+            const std::size_t len = round_up(bytes, huge_page);
+            void *raw = mmap(nullptr, len + huge_page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED)
+            {
+                std::fprintf(stderr, "error: could not map %zu bytes for the state-vector.\n", len);
+                std::exit(EXIT_FAILURE);
+            }
+            const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(raw);
+            const std::uintptr_t aligned = round_up(base, huge_page);
+            if (aligned > base)
+                munmap(raw, aligned - base);
+            munmap(reinterpret_cast<void *>(aligned + len), base + huge_page - aligned);
+#if defined(MADV_HUGEPAGE)
+            madvise(reinterpret_cast<void *>(aligned), len, MADV_HUGEPAGE);
+#endif
+            return reinterpret_cast<void *>(aligned);
+        }
+#endif
+        return ::operator new(round_up(bytes, alignment), std::align_val_t(alignment));
+    }
+
+    void allocator::deallocate(void *__p, const std::size_t &bytes)
+    {
+        if (!__p)
+            return;
+#if defined(__unix__) && defined(MAP_ANONYMOUS)
+        if (bytes >= huge_page)
+        {
+            munmap(__p, round_up(bytes, huge_page));
+            return;
+        }
+#endif
+        ::operator delete(__p, std::align_val_t(alignment));
+    }
+
+    void allocator::first_touch(void *__p, const std::size_t &bytes)
+    {
+        // the pool splits [0, lines) into one contiguous chunk per thread, as it does for the kernels' pair ranges, and the
+        // grain keeps every chunk boundary on a huge page boundary
+        char *c = static_cast<char *>(__p);
+        const std::size_t lines = round_up(bytes, alignment) / alignment;
+        thread_pool::get().parallel_for(lines, huge_page / alignment, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            const std::size_t end = e * alignment < bytes ? e * alignment : bytes;
+            std::memset(c + b * alignment, 0, end - b * alignment); });
+    }
+
+    void allocator::copy(void *__dst, const void *__src, const std::size_t &bytes)
+    {
+        char *d = static_cast<char *>(__dst);
+        const char *c = static_cast<const char *>(__src);
+        const std::size_t lines = round_up(bytes, alignment) / alignment;
+        thread_pool::get().parallel_for(lines, huge_page / alignment, [&](const std::size_t &b, const std::size_t &e)
+                                        {
+            const std::size_t end = e * alignment < bytes ? e * alignment : bytes;
+            std::memcpy(d + b * alignment, c + b * alignment, end - b * alignment); });
+    }
+}
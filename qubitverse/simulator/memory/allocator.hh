@@ -0,0 +1,33 @@
+/**
+ * @file allocator.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_ALLOCATOR
+#define SIMULATOR_ALLOCATOR
+
+#include <cstddef>
+
+namespace simulator
+{
+    // storage for state-vectors: cache-line aligned, and for anything of a huge page or more, mapped directly from the OS on a
+    // 2 MiB boundary with transparent huge pages requested, so that a 30-qubit sweep is not bound by TLB misses
+    class allocator
+    {
+      public:
+        static constexpr std::size_t alignment = 64;
+        static constexpr std::size_t huge_page = 2ULL << 20;
+
+        // `bytes` of storage, the pages are not touched yet (see `first_touch`), the same `bytes` must be given back to `deallocate`
+        [[nodiscard]] static void *allocate(const std::size_t &bytes);
+        static void deallocate(void *__p, const std::size_t &bytes);
+        // zero-fills the storage over the thread pool, with the same static partition the kernels use: every page is first
+        // touched, and therefore placed on the NUMA node of, the thread that later sweeps it, huge pages are never split
+        static void first_touch(void *__p, const std::size_t &bytes);
+        // memcpy over the thread pool, with the partition of `first_touch`, so a copy is placed like a fresh vector
+        static void copy(void *__dst, const void *__src, const std::size_t &bytes);
+    };
+}
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * @file buffer_pool.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./buffer_pool.hh"
+#include "./allocator.hh"
+
+#include <cstdlib>
+#include <iterator>
+
+namespace simulator
+{
+    buffer_pool::buffer_pool()
+        : M_pooled(0), M_capacity(default_capacity)
+    {
+        if (const char *env = std::getenv("QUBITVERSE_POOL_MB"))
+        {
+            const long long v = std::atoll(env);
+            if (v >= 0)
+                this->M_capacity = static_cast<std::size_t>(v) << 20;
+        }
+    }
+
+    void buffer_pool::evict(const std::size_t &incoming, const std::size_t &keep)
+    {
+        for (auto it = this->M_buckets.begin(); it != this->M_buckets.end() && this->M_pooled + incoming > this->M_capacity;)
+        {
+            if (it->first == keep)
+            {
+                ++it;
+                continue;
+            }
+            while (!it->second.empty() && this->M_pooled + incoming > this->M_capacity)
+            {
+                allocator::deallocate(it->second.back(), it->first);
+                it->second.pop_back();
+                this->M_pooled -= it->first;
+            }
+            it = it->second.empty() ? this->M_buckets.erase(it) : std::next(it);
+        }
+
+        // still too much: the bucket of the incoming size gives way as well
+        auto it = this->M_buckets.find(keep);
+        while (it != this->M_buckets.end() && !it->second.empty() && this->M_pooled + incoming > this->M_capacity)
+        {
+            allocator::deallocate(it->second.back(), it->first);
+            it->second.pop_back();
+            this->M_pooled -= it->first;
+        }
+    }
+
+    buffer_pool &buffer_pool::get()
+    {
+        static buffer_pool pool;
+        return pool;
+    }
+
+    void *buffer_pool::acquire(const std::size_t &bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lk(this->M_lock);
+            auto it = this->M_buckets.find(bytes);
+            if (it != this->M_buckets.end() && !it->second.empty())
+            {
+                void *p = it->second.back();
+                it->second.pop_back();
+                this->M_pooled -= bytes;
+                return p;
+            }
+        }
+        return allocator::allocate(bytes);
+    }
+
+    void buffer_pool::release(void *__p, const std::size_t &bytes)
+    {
+        if (!__p)
+            return;
+        {
+            std::lock_guard<std::mutex> lk(this->M_lock);
+            if (bytes <= this->M_capacity)
+            {
+                // the most recent width is the likeliest next one, older sizes make room for it
+                this->evict(bytes, bytes);
+                this->M_buckets[bytes].push_back(__p);
+                this->M_pooled += bytes;
+                return;
+            }
+        }
+        allocator::deallocate(__p, bytes);
+    }
+
+    void buffer_pool::set_capacity(const std::size_t &bytes)
+    {
+        std::lock_guard<std::mutex> lk(this->M_lock);
+        this->M_capacity = bytes;
+        this->evict(0, 0);
+    }
+
+    const std::size_t &buffer_pool::get_capacity() const
+    {
+        return this->M_capacity;
+    }
+
+    const std::size_t &buffer_pool::get_pooled() const
+    {
+        return this->M_pooled;
+    }
+
+    buffer_pool::~buffer_pool()
+    {
+        for (auto &[bytes, buffers] : this->M_buckets)
+            for (void *p : buffers)
+                allocator::deallocate(p, bytes);
+    }
+}
@@ -0,0 +1,50 @@
+/**
+ * @file buffer_pool.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_BUFFER_POOL
+#define SIMULATOR_BUFFER_POOL
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace simulator
+{
+    // process-wide cache of state-vector buffers, bucketed by size: a request releasing its vector leaves it mapped and already
+    // placed on the right NUMA nodes, so the next request of the same width skips the allocation and every page fault
+    // at most `QUBITVERSE_POOL_MB` MiB (default 1024) are kept, 0 disables the pool
+    class buffer_pool
+    {
+      public:
+        static constexpr std::size_t default_capacity = 1ULL << 30;
+
+      private:
+        std::map<std::size_t, std::vector<void *>> M_buckets;
+        std::mutex M_lock;
+        std::size_t M_pooled, M_capacity;
+
+        buffer_pool();
+        // frees pooled buffers, other sizes than `keep` first, until `M_pooled + incoming` fits the capacity
+        void evict(const std::size_t &incoming, const std::size_t &keep);
+
+      public:
+        buffer_pool(const buffer_pool &) = delete;
+        buffer_pool &operator=(const buffer_pool &) = delete;
+
+        [[nodiscard]] static buffer_pool &get();
+        // `bytes` of storage with undefined contents, from the bucket of that size or freshly from `allocator`
+        [[nodiscard]] void *acquire(const std::size_t &bytes);
+        // hands the buffer back, it stays pooled if it fits the capacity and is unmapped otherwise
+        void release(void *__p, const std::size_t &bytes);
+        void set_capacity(const std::size_t &bytes);
+        [[nodiscard]] const std::size_t &get_capacity() const;
+        [[nodiscard]] const std::size_t &get_pooled() const;
+        ~buffer_pool();
+    };
+}
+
+#endif
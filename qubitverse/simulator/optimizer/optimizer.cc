@@ -0,0 +1,423 @@
+/**
+ * @file optimizer.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./optimizer.hh"
+#include <cmath>
+#include <algorithm>
+
+namespace simulator
+{
+    bool optimizer::single_gate_matrix(const ast_single_gate_node &__g, complex (&__m)[2][2])
+    {
+        const double theta = __g.M_theta * (M_PI / 180.0);
+        const double c = std::cos(theta / 2.0), s = std::sin(theta / 2.0);
+        __m[0][0] = 1.0;
+        __m[0][1] = 0.0;
+        __m[1][0] = 0.0;
+        __m[1][1] = 1.0;
+
+        if (__g.M_gate == "I")
+            ;
+        else if (__g.M_gate == "X")
+        {
+            __m[0][0] = __m[1][1] = 0.0;
+            __m[0][1] = __m[1][0] = 1.0;
+        }
+        else if (__g.M_gate == "Y")
+        {
+            __m[0][0] = __m[1][1] = 0.0;
+            __m[0][1] = {0.0, -1.0};
+            __m[1][0] = {0.0, 1.0};
+        }
+        else if (__g.M_gate == "Z")
+            __m[1][1] = -1.0;
+        else if (__g.M_gate == "H")
+        {
+            __m[0][0] = __m[0][1] = __m[1][0] = M_SQRT1_2;
+            __m[1][1] = -M_SQRT1_2;
+        }
+        else if (__g.M_gate == "S")
+            __m[1][1] = {0.0, 1.0};
+        else if (__g.M_gate == "T")
+            __m[1][1] = {M_SQRT1_2, M_SQRT1_2};
+        else if (__g.M_gate == "P")
+            __m[1][1] = std::polar(1.0, theta);
+        else if (__g.M_gate == "Rx")
+        {
+            __m[0][0] = __m[1][1] = c;
+            __m[0][1] = __m[1][0] = {0.0, -s};
+        }
+        else if (__g.M_gate == "Ry")
+        {
+            __m[0][0] = __m[1][1] = c;
+            __m[0][1] = -s;
+            __m[1][0] = s;
+        }
+        else if (__g.M_gate == "Rz")
+        {
+            __m[0][0] = std::polar(1.0, -theta / 2.0);
+            __m[1][1] = std::polar(1.0, theta / 2.0);
+        }
+        else if (__g.M_gate == "V")
+        {
+            __m[0][0] = __m[1][1] = {0.5, 0.5};
+            __m[0][1] = __m[1][0] = {0.5, -0.5};
+        }
+        else if (__g.M_gate == "adjV")
+        {
+            __m[0][0] = __m[1][1] = {0.5, -0.5};
+            __m[0][1] = __m[1][0] = {0.5, 0.5};
+        }
+        else
+            return false;
+        return true;
+    }
+
+    bool optimizer::diagonal_entries(const ast_node &__g, complex (&__d)[2], std::size_t &qubit)
+    {
+        complex m[2][2];
+        if (__g.get_gate_type() == gate_type::SINGLE_GATE)
+        {
+            const ast_single_gate_node &casted = static_cast<const ast_single_gate_node &>(__g);
+            if (!optimizer::single_gate_matrix(casted, m))
+                return false;
+            qubit = casted.M_qubit;
+        }
+        else if (__g.get_gate_type() == gate_type::FUSED_GATE)
+        {
+            const ast_fused_gate_node &casted = static_cast<const ast_fused_gate_node &>(__g);
+            std::copy(&casted.M_matrix[0][0], &casted.M_matrix[0][0] + 4, &m[0][0]);
+            qubit = casted.M_qubit;
+        }
+        else
+            return false;
+
+        if (m[0][1] != 0.0 || m[1][0] != 0.0)
+            return false;
+        __d[0] = m[0][0];
+        __d[1] = m[1][1];
+        return true;
+    }
+
+    std::size_t optimizer::diagonal_slot(ast_diagonal_run_node &__run, const std::size_t &qubit)
+    {
+        for (std::size_t m = 0; m < __run.M_qubits.size(); m++)
+            if (__run.M_qubits[m] == qubit)
+                return m;
+
+        // a new qubit doubles the table, the new upper half starts as a copy of the lower half
+        __run.M_qubits.push_back(qubit);
+        __run.M_phases.reserve(__run.M_phases.size() * 2);
+        __run.M_phases.insert(__run.M_phases.end(), __run.M_phases.begin(), __run.M_phases.end());
+        return __run.M_qubits.size() - 1;
+    }
+
+    void optimizer::flush_diagonal_run(std::vector<std::unique_ptr<ast_node>> &__out, std::unique_ptr<ast_diagonal_run_node> &__run, std::unique_ptr<ast_node> &__first)
+    {
+        // a run of one gate keeps its own node, the single-gate kernels are cheaper than a table sweep
+        if (__run->M_merged == 1)
+            __out.push_back(std::move(__first));
+        else if (__run->M_merged > 1)
+            __out.push_back(std::move(__run));
+        __run = std::make_unique<ast_diagonal_run_node>();
+        __first.reset();
+    }
+
+    void optimizer::merge_diagonal_runs(std::vector<std::unique_ptr<ast_node>> &gates)
+    {
+        std::vector<std::unique_ptr<ast_node>> out;
+        out.reserve(gates.size());
+        std::unique_ptr<ast_diagonal_run_node> run = std::make_unique<ast_diagonal_run_node>();
+        std::unique_ptr<ast_node> first;
+
+        for (std::unique_ptr<ast_node> &node : gates)
+        {
+            std::size_t qubits[2], nq;
+            complex d[2];
+            if (optimizer::diagonal_entries(*node, d, qubits[0]))
+                nq = 1;
+            else if (node->get_gate_type() == gate_type::CZ_GATE && static_cast<ast_cz_gate_node *>(node.get())->M_control != static_cast<ast_cz_gate_node *>(node.get())->M_target)
+            {
+                qubits[0] = static_cast<ast_cz_gate_node *>(node.get())->M_control;
+                qubits[1] = static_cast<ast_cz_gate_node *>(node.get())->M_target;
+                nq = 2;
+            }
+            else
+            {
+                // not diagonal, or a malformed CZ (control == target), which is left for the simulation to report
+                optimizer::flush_diagonal_run(out, run, first);
+                out.push_back(std::move(node));
+                continue;
+            }
+
+            std::size_t fresh = 0;
+            for (std::size_t k = 0; k < nq; k++)
+            {
+                bool seen = false;
+                for (const std::size_t &q : run->M_qubits)
+                    seen = seen || q == qubits[k];
+                fresh += seen ? 0 : 1;
+            }
+            if (run->M_qubits.size() + fresh > optimizer::max_diagonal_qubits)
+                optimizer::flush_diagonal_run(out, run, first);
+
+            if (nq == 1)
+            {
+                const std::size_t bit = 1ULL << optimizer::diagonal_slot(*run, qubits[0]);
+                for (std::size_t k = 0; k < run->M_phases.size(); k++)
+                    run->M_phases[k] *= (k & bit) ? d[1] : d[0];
+            }
+            else
+            {
+                const std::size_t bits = (1ULL << optimizer::diagonal_slot(*run, qubits[0])) | (1ULL << optimizer::diagonal_slot(*run, qubits[1]));
+                for (std::size_t k = 0; k < run->M_phases.size(); k++)
+                    if ((k & bits) == bits)
+                        run->M_phases[k] = -run->M_phases[k];
+            }
+
+            if (run->M_merged++ == 0)
+                first = std::move(node);
+        }
+        optimizer::flush_diagonal_run(out, run, first);
+        gates = std::move(out);
+    }
+
+    void optimizer::flush_single_qubit(std::vector<std::unique_ptr<ast_node>> &__out, pending_chain &__chain, const std::size_t &qubit)
+    {
+        // a chain of one gate keeps its own node, so X and diagonal gates still reach their dedicated kernels
+        if (__chain.M_count == 1)
+            __out.push_back(std::move(__chain.M_first));
+        else if (__chain.M_count > 1)
+            __out.emplace_back(new ast_fused_gate_node(qubit, __chain.M_matrix, __chain.M_count));
+        __chain = pending_chain();
+    }
+
+    void optimizer::fuse_single_qubit(std::vector<std::unique_ptr<ast_node>> &gates, const std::size_t &nqubits)
+    {
+        std::vector<std::unique_ptr<ast_node>> out;
+        out.reserve(gates.size());
+        std::vector<pending_chain> chains(nqubits);
+
+        for (std::unique_ptr<ast_node> &node : gates)
+        {
+            complex m[2][2];
+            if (node->get_gate_type() == gate_type::SINGLE_GATE && optimizer::single_gate_matrix(*static_cast<ast_single_gate_node *>(node.get()), m))
+            {
+                const std::size_t q = static_cast<ast_single_gate_node *>(node.get())->M_qubit;
+                if (q < nqubits)
+                {
+                    pending_chain &chain = chains[q];
+                    // the later gate multiplies from the left: M_matrix = m * M_matrix
+                    complex r[2][2];
+                    for (std::size_t i = 0; i < 2; i++)
+                        for (std::size_t j = 0; j < 2; j++)
+                            r[i][j] = m[i][0] * chain.M_matrix[0][j] + m[i][1] * chain.M_matrix[1][j];
+                    std::copy(&r[0][0], &r[0][0] + 4, &chain.M_matrix[0][0]);
+                    if (chain.M_count++ == 0)
+                        chain.M_first = std::move(node);
+                    continue;
+                }
+            }
+
+            // any other node ends the chains on the qubits it touches (everything, if its qubits are unknown here)
+            std::size_t touched[2], nt = 0;
+            switch (node->get_gate_type())
+            {
+            case gate_type::CNOT_GATE:
+                touched[nt++] = static_cast<ast_cnot_gate_node *>(node.get())->M_control;
+                touched[nt++] = static_cast<ast_cnot_gate_node *>(node.get())->M_target;
+                break;
+            case gate_type::CZ_GATE:
+                touched[nt++] = static_cast<ast_cz_gate_node *>(node.get())->M_control;
+                touched[nt++] = static_cast<ast_cz_gate_node *>(node.get())->M_target;
+                break;
+            case gate_type::SWAP_GATE:
+                touched[nt++] = static_cast<ast_swap_gate_node *>(node.get())->M_qubit1;
+                touched[nt++] = static_cast<ast_swap_gate_node *>(node.get())->M_qubit2;
+                break;
+            case gate_type::MEASURE_NTH:
+                touched[nt++] = static_cast<ast_measure_nth_node *>(node.get())->M_qubit;
+                break;
+            default:
+                for (std::size_t q = 0; q < nqubits; q++)
+                    optimizer::flush_single_qubit(out, chains[q], q);
+                break;
+            }
+            for (std::size_t k = 0; k < nt; k++)
+                if (touched[k] < nqubits)
+                    optimizer::flush_single_qubit(out, chains[touched[k]], touched[k]);
+            out.push_back(std::move(node));
+        }
+        for (std::size_t q = 0; q < nqubits; q++)
+            optimizer::flush_single_qubit(out, chains[q], q);
+        gates = std::move(out);
+    }
+
+    bool optimizer::block_qubits(const ast_node &__g, std::size_t (&__q)[2], std::size_t &nq)
+    {
+        complex m[2][2];
+        switch (__g.get_gate_type())
+        {
+        case gate_type::SINGLE_GATE:
+            if (!optimizer::single_gate_matrix(static_cast<const ast_single_gate_node &>(__g), m))
+                return false;
+            __q[0] = static_cast<const ast_single_gate_node &>(__g).M_qubit;
+            nq = 1;
+            return true;
+        case gate_type::FUSED_GATE:
+            __q[0] = static_cast<const ast_fused_gate_node &>(__g).M_qubit;
+            nq = 1;
+            return true;
+        case gate_type::CNOT_GATE:
+            __q[0] = static_cast<const ast_cnot_gate_node &>(__g).M_control;
+            __q[1] = static_cast<const ast_cnot_gate_node &>(__g).M_target;
+            break;
+        case gate_type::CZ_GATE:
+            __q[0] = static_cast<const ast_cz_gate_node &>(__g).M_control;
+            __q[1] = static_cast<const ast_cz_gate_node &>(__g).M_target;
+            break;
+        case gate_type::SWAP_GATE:
+            __q[0] = static_cast<const ast_swap_gate_node &>(__g).M_qubit1;
+            __q[1] = static_cast<const ast_swap_gate_node &>(__g).M_qubit2;
+            break;
+        default:
+            return false;
+        }
+        nq = 2;
+        return __q[0] != __q[1]; // malformed two-qubit gates are left for the simulation to report
+    }
+
+    std::size_t optimizer::block_slot(pending_block &__block, const std::size_t &qubit)
+    {
+        for (std::size_t m = 0; m < __block.M_qubits.size(); m++)
+            if (__block.M_qubits[m] == qubit)
+                return m;
+
+        // a new qubit becomes the highest local bit, the matrix grows to I (x) M_matrix
+        const std::size_t dim = 1ULL << __block.M_qubits.size();
+        std::vector<complex> grown(4 * dim * dim, 0.0);
+        for (std::size_t h = 0; h < 2; h++)
+            for (std::size_t r = 0; r < dim; r++)
+                std::copy(__block.M_matrix.begin() + r * dim, __block.M_matrix.begin() + (r + 1) * dim, grown.begin() + (h * dim + r) * 2 * dim + h * dim);
+        __block.M_matrix = std::move(grown);
+        __block.M_qubits.push_back(qubit);
+        return __block.M_qubits.size() - 1;
+    }
+
+    void optimizer::absorb_into_block(pending_block &__block, std::unique_ptr<ast_node> &__g)
+    {
+        // the later gate multiplies from the left, so it only ever mixes rows of the block's matrix
+        std::size_t q[2], nq;
+        (void)optimizer::block_qubits(*__g, q, nq);
+        const std::size_t a = 1ULL << optimizer::block_slot(__block, q[0]);
+        const std::size_t b = nq == 2 ? 1ULL << optimizer::block_slot(__block, q[1]) : 0;
+        const std::size_t dim = 1ULL << __block.M_qubits.size();
+        std::vector<complex> &u = __block.M_matrix;
+        auto swap_rows = [&](const std::size_t &r1, const std::size_t &r2)
+        { std::swap_ranges(u.begin() + r1 * dim, u.begin() + (r1 + 1) * dim, u.begin() + r2 * dim); };
+
+        switch (__g->get_gate_type())
+        {
+        case gate_type::SINGLE_GATE:
+        case gate_type::FUSED_GATE:
+        {
+            complex m[2][2];
+            if (__g->get_gate_type() == gate_type::SINGLE_GATE)
+                (void)optimizer::single_gate_matrix(*static_cast<ast_single_gate_node *>(__g.get()), m);
+            else
+                std::copy(&static_cast<ast_fused_gate_node *>(__g.get())->M_matrix[0][0], &static_cast<ast_fused_gate_node *>(__g.get())->M_matrix[0][0] + 4, &m[0][0]);
+            for (std::size_t r = 0; r < dim; r++)
+            {
+                if (r & a)
+                    continue;
+                for (std::size_t c = 0; c < dim; c++)
+                {
+                    const complex v0 = u[r * dim + c], v1 = u[(r | a) * dim + c];
+                    u[r * dim + c] = m[0][0] * v0 + m[0][1] * v1;
+                    u[(r | a) * dim + c] = m[1][0] * v0 + m[1][1] * v1;
+                }
+            }
+            break;
+        }
+        case gate_type::CNOT_GATE:
+            for (std::size_t r = 0; r < dim; r++)
+                if ((r & a) && !(r & b))
+                    swap_rows(r, r | b);
+            break;
+        case gate_type::CZ_GATE:
+            for (std::size_t r = 0; r < dim; r++)
+                if ((r & a) && (r & b))
+                    for (std::size_t c = 0; c < dim; c++)
+                        u[r * dim + c] = -u[r * dim + c];
+            break;
+        case gate_type::SWAP_GATE:
+            for (std::size_t r = 0; r < dim; r++)
+                if ((r & a) && !(r & b))
+                    swap_rows(r, (r & ~a) | b);
+            break;
+        default:
+            break;
+        }
+        __block.M_nodes.push_back(std::move(__g));
+    }
+
+    void optimizer::flush_block(std::vector<std::unique_ptr<ast_node>> &__out, pending_block &__block)
+    {
+        // a single gate already has its own (cheaper) kernel, and a diagonal block is better served by `merge_diagonal_runs`
+        const std::size_t dim = 1ULL << __block.M_qubits.size();
+        bool diagonal = true;
+        for (std::size_t r = 0; r < dim && diagonal; r++)
+            for (std::size_t c = 0; c < dim && diagonal; c++)
+                diagonal = r == c || __block.M_matrix[r * dim + c] == 0.0;
+
+        if (__block.M_nodes.size() == 1 || diagonal)
+            for (std::unique_ptr<ast_node> &node : __block.M_nodes)
+                __out.push_back(std::move(node));
+        else if (__block.M_qubits.size() == 1)
+        {
+            const complex m[2][2] = {{__block.M_matrix[0], __block.M_matrix[1]}, {__block.M_matrix[2], __block.M_matrix[3]}};
+            __out.emplace_back(new ast_fused_gate_node(__block.M_qubits[0], m, __block.M_nodes.size()));
+        }
+        else
+            __out.emplace_back(new ast_block_gate_node(std::move(__block.M_qubits), std::move(__block.M_matrix), __block.M_nodes.size()));
+        __block = pending_block();
+    }
+
+    void optimizer::fuse_blocks(std::vector<std::unique_ptr<ast_node>> &gates, const std::size_t &max_qubits)
+    {
+        const std::size_t width = std::clamp<std::size_t>(max_qubits, 2, optimizer::max_block_qubits);
+        std::vector<std::unique_ptr<ast_node>> out;
+        out.reserve(gates.size());
+        pending_block block;
+
+        for (std::unique_ptr<ast_node> &node : gates)
+        {
+            std::size_t q[2], nq;
+            if (!optimizer::block_qubits(*node, q, nq))
+            {
+                optimizer::flush_block(out, block);
+                out.push_back(std::move(node));
+                continue;
+            }
+
+            std::size_t fresh = 0;
+            for (std::size_t k = 0; k < nq; k++)
+                fresh += std::find(block.M_qubits.begin(), block.M_qubits.end(), q[k]) == block.M_qubits.end() ? 1 : 0;
+            // a SWAP is a free relabel in `qubit`, it is only worth absorbing when the block already spans both of its qubits
+            if (node->get_gate_type() == gate_type::SWAP_GATE && fresh > 0)
+            {
+                optimizer::flush_block(out, block);
+                out.push_back(std::move(node));
+                continue;
+            }
+            if (block.M_qubits.size() + fresh > width)
+                optimizer::flush_block(out, block);
+            optimizer::absorb_into_block(block, node);
+        }
+        optimizer::flush_block(out, block);
+        gates = std::move(out);
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file optimizer.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_OPTIMIZER
+#define SIMULATOR_OPTIMIZER
+
+#include <vector>
+#include <memory>
+#include <complex>
+#include "../parser/ast.hh"
+
+namespace simulator
+{
+    // rewrites the parsed gate list into an equivalent but cheaper one, runs between `parser::perform` and the simulation
+    // passes change how many state-vector sweeps happen, so they only run when no per-gate trace is requested
+    class optimizer
+    {
+      public:
+        using complex = std::complex<double>;
+
+        // largest number of distinct qubits a merged diagonal run may span, its phase table has 2^N entries
+        static constexpr std::size_t max_diagonal_qubits = 10;
+        // widest block `fuse_blocks` may build, bounded by the dense kernel
+        static constexpr std::size_t max_block_qubits = 5;
+
+      private:
+        // product of the single-qubit gates seen so far on one wire
+        struct pending_chain
+        {
+            complex M_matrix[2][2] = {{1.0, 0.0}, {0.0, 1.0}};
+            std::size_t M_count = 0;
+            std::unique_ptr<ast_node> M_first;
+        };
+
+        // product of the gates absorbed so far into one block, the original nodes are kept until the block is emitted
+        struct pending_block
+        {
+            std::vector<std::size_t> M_qubits;
+            std::vector<complex> M_matrix = {1.0};
+            std::vector<std::unique_ptr<ast_node>> M_nodes;
+        };
+
+        static void flush_single_qubit(std::vector<std::unique_ptr<ast_node>> &__out, pending_chain &__chain, const std::size_t &qubit);
+        static void flush_diagonal_run(std::vector<std::unique_ptr<ast_node>> &__out, std::unique_ptr<ast_diagonal_run_node> &__run, std::unique_ptr<ast_node> &__first);
+        static std::size_t diagonal_slot(ast_diagonal_run_node &__run, const std::size_t &qubit);
+        static void flush_block(std::vector<std::unique_ptr<ast_node>> &__out, pending_block &__block);
+        static std::size_t block_slot(pending_block &__block, const std::size_t &qubit);
+        static bool block_qubits(const ast_node &__g, std::size_t (&__q)[2], std::size_t &nq);
+        static void absorb_into_block(pending_block &__block, std::unique_ptr<ast_node> &__g);
+
+      public:
+        // 2x2 matrix of a named single-qubit gate, false for an unknown name (angles arrive in degrees, as sent by the frontend)
+        [[nodiscard]] static bool single_gate_matrix(const ast_single_gate_node &__g, complex (&__m)[2][2]);
+        // diagonal entries and qubit of a single-qubit (or fused) gate node, false if the node is not a diagonal single-qubit gate
+        [[nodiscard]] static bool diagonal_entries(const ast_node &__g, complex (&__d)[2], std::size_t &qubit);
+        // multiplies every chain of consecutive single-qubit gates on the same wire into one `ast_fused_gate_node`,
+        // a chain ends at the next multi-qubit gate or measurement touching that wire
+        static void fuse_single_qubit(std::vector<std::unique_ptr<ast_node>> &gates, const std::size_t &nqubits);
+        // merges every run of consecutive diagonal gates (Z, S, T, P, Rz, CZ) into one `ast_diagonal_run_node`
+        static void merge_diagonal_runs(std::vector<std::unique_ptr<ast_node>> &gates);
+        // greedily multiplies consecutive gates (single-qubit, fused, CNOT, CZ, SWAP) into `ast_block_gate_node`s spanning at most
+        // `max_qubits` (2 to max_block_qubits) qubits, a block is closed by the first gate that would widen it further or by any
+        // other node, blocks of one gate and purely diagonal blocks are left as their original gates, a SWAP reaching outside
+        // the open block is left alone as well (it costs nothing on its own)
+        static void fuse_blocks(std::vector<std::unique_ptr<ast_node>> &gates, const std::size_t &max_qubits);
+    };
+}
+
+#endif
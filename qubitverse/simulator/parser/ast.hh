@@ -8,6 +8,8 @@
 #define SIMULATOR_AST
 
 #include <string>
+#include <vector>
+#include <complex>
 
 namespace simulator
 {
@@ -17,7 +19,10 @@ namespace simulator
         CNOT_GATE,
         CZ_GATE,
         SWAP_GATE,
-        MEASURE_NTH
+        MEASURE_NTH,
+        DIAGONAL_RUN,
+        FUSED_GATE,
+        BLOCK_GATE
     };
 
     class ast_node
@@ -85,6 +90,49 @@ namespace simulator
 
         gate_type get_gate_type() const override { return gate_type::MEASURE_NTH; }
     };
+
+    // produced by the optimizer, never by the parser: consecutive diagonal gates (Z, S, T, P, Rz, CZ) merged into one phase table
+    // bit m of a table index is the value of qubit `M_qubits[m]`
+    class ast_diagonal_run_node : public ast_node
+    {
+      public:
+        std::vector<std::size_t> M_qubits;
+        std::vector<std::complex<double>> M_phases;
+        std::size_t M_merged;
+
+        ast_diagonal_run_node() : M_phases(1, 1.0), M_merged(0) {}
+
+        gate_type get_gate_type() const override { return gate_type::DIAGONAL_RUN; }
+    };
+
+    // produced by the optimizer: a chain of single-qubit gates on one wire multiplied into one 2x2 matrix
+    class ast_fused_gate_node : public ast_node
+    {
+      public:
+        std::size_t M_qubit;
+        std::complex<double> M_matrix[2][2];
+        std::size_t M_merged;
+
+        ast_fused_gate_node(const std::size_t &q, const std::complex<double> (&m)[2][2], const std::size_t &merged)
+            : M_qubit(q), M_matrix{{m[0][0], m[0][1]}, {m[1][0], m[1][1]}}, M_merged(merged) {}
+
+        gate_type get_gate_type() const override { return gate_type::FUSED_GATE; }
+    };
+
+    // produced by the optimizer: neighbouring gates over at most a few qubits multiplied into one dense 2^N x 2^N matrix
+    // `M_matrix` is row-major, bit m of a row/column index is the value of qubit `M_qubits[m]`
+    class ast_block_gate_node : public ast_node
+    {
+      public:
+        std::vector<std::size_t> M_qubits;
+        std::vector<std::complex<double>> M_matrix;
+        std::size_t M_merged;
+
+        ast_block_gate_node(std::vector<std::size_t> &&q, std::vector<std::complex<double>> &&m, const std::size_t &merged)
+            : M_qubits(std::move(q)), M_matrix(std::move(m)), M_merged(merged) {}
+
+        gate_type get_gate_type() const override { return gate_type::BLOCK_GATE; }
+    };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -16,6 +16,21 @@ namespace simulator
         this->M_nqubs = std::stoul(toks[i++].M_val, (std::size_t *)0, 10);
         this->M_gatelist.reserve(this->M_nqubs);
 
+        while (i < toks.size() && toks[i].M_val != "type")
+        {
+            // every option is `key:value[:value...]`, a key without a value is a malformed request, not an empty option
+            if (toks[i].M_type != token_type::IDEN || i + 2 >= toks.size() || toks[i + 1].M_type != token_type::COLON || toks[i + 2].M_type != token_type::IDEN)
+                return false;
+            std::vector<std::string> &vals = this->M_options[toks[i++].M_val];
+            while (i + 1 < toks.size() && toks[i].M_type == token_type::COLON)
+            {
+                vals.push_back(toks[i + 1].M_val);
+                i += 2; // skips ':' and the value
+            }
+            if (i < toks.size() && toks[i].M_type == token_type::SEP)
+                i++;
+        }
+
         for (; i < toks.size();)
         {
             if (toks[i].M_val == "type")
@@ -118,8 +133,27 @@ namespace simulator
         return this->M_nqubs;
     }
 
+    bool parser::has_option(const std::string &key) const
+    {
+        return this->M_options.find(key) != this->M_options.end();
+    }
+
+    const std::vector<std::string> &parser::get_option(const std::string &key) const
+    {
+        static const std::vector<std::string> none;
+        auto it = this->M_options.find(key);
+        return it == this->M_options.end() ? none : it->second;
+    }
+
     void parser::debug_print() const
     {
+        for (const auto &[key, vals] : this->M_options)
+        {
+            std::printf("OPTION: [%s:", key.c_str());
+            for (const std::string &v : vals)
+                std::printf(" %s", v.c_str());
+            std::puts("]");
+        }
         for (const auto &i : this->M_gatelist)
         {
             if (i->get_gate_type() == gate_type::SINGLE_GATE)
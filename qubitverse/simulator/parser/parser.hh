@@ -9,6 +9,7 @@
 
 #include <vector>
 #include <memory>
+#include <unordered_map>
 #include "../lexer/token.hh"
 #include "./ast.hh"
 
@@ -19,12 +20,17 @@ namespace simulator
       private:
         std::vector<std::unique_ptr<ast_node>> M_gatelist;
         std::size_t M_nqubs;
+        // request options, written as `key:value[:value...]` lines between `n` and the first gate
+        std::unordered_map<std::string, std::vector<std::string>> M_options;
 
       public:
         parser() = default;
         [[nodiscard]] bool perform(std::vector<token> &toks);
         [[nodiscard]] std::vector<std::unique_ptr<ast_node>> &get();
         [[nodiscard]] const std::size_t &get_no_qubits() const;
+        [[nodiscard]] bool has_option(const std::string &key) const;
+        // values of `key`, in the order they were given (repeated keys append), empty if the option is absent
+        [[nodiscard]] const std::vector<std::string> &get_option(const std::string &key) const;
         void debug_print() const;
         ~parser() = default;
     };
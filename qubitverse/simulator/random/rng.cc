@@ -0,0 +1,71 @@
+/**
+ * @file rng.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./rng.hh"
+
+#include <random>
+
+namespace simulator
+{
+    philox::block philox::generate(block ctr, const std::uint64_t &key)
+    {
+        std::uint32_t k0 = static_cast<std::uint32_t>(key), k1 = static_cast<std::uint32_t>(key >> 32);
+        for (std::size_t round = 0; round < 10; round++)
+        {
+            const std::uint64_t p0 = 0xD2511F53ULL * ctr[0], p1 = 0xCD9E8D57ULL * ctr[2];
+            ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ k0, static_cast<std::uint32_t>(p1),
+                   static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ k1, static_cast<std::uint32_t>(p0)};
+            k0 += 0x9E3779B9U;
+            k1 += 0xBB67AE85U;
+        }
+        return ctr;
+    }
+
+    rng_stream::rng_stream(const std::uint64_t &seed, const std::uint64_t &stream)
+        : M_seed(seed), M_stream(stream), M_index(0), M_block{}, M_used(4) {}
+
+    std::uint32_t rng_stream::next_u32()
+    {
+        if (this->M_used == 4)
+        {
+            this->M_block = philox::generate({static_cast<std::uint32_t>(this->M_index), static_cast<std::uint32_t>(this->M_index >> 32),
+                                              static_cast<std::uint32_t>(this->M_stream), static_cast<std::uint32_t>(this->M_stream >> 32)},
+                                             this->M_seed);
+            this->M_index++;
+            this->M_used = 0;
+        }
+        return this->M_block[this->M_used++];
+    }
+
+    std::uint64_t rng_stream::next_u64()
+    {
+        const std::uint64_t hi = this->next_u32();
+        return (hi << 32) | this->next_u32();
+    }
+
+    double rng_stream::uniform()
+    {
+        return static_cast<double>(this->next_u64() >> 11) * 0x1.0p-53;
+    }
+
+    rng::rng()
+        : M_base((static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}()), M_next(0) {}
+
+    rng &rng::get()
+    {
+        static rng instance;
+        return instance;
+    }
+
+    std::uint64_t rng::fresh_seed()
+    {
+        // splitmix64 of base + counter, consecutive seeds share no obvious bit pattern
+        std::uint64_t z = this->M_base + 0x9E3779B97F4A7C15ULL * (this->M_next.fetch_add(1, std::memory_order_relaxed) + 1);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+}
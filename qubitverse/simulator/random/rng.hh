@@ -0,0 +1,64 @@
+/**
+ * @file rng.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_RNG
+#define SIMULATOR_RNG
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace simulator
+{
+    // Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"): a keyed bijection of a 128-bit counter,
+    // so the n-th block of any stream is computed directly, with no state to seed, share or lock
+    class philox
+    {
+      public:
+        using block = std::array<std::uint32_t, 4>;
+
+        [[nodiscard]] static block generate(block ctr, const std::uint64_t &key);
+    };
+
+    // one independent stream of random numbers: the key is the seed, the counter holds the stream id and the position in it,
+    // the same (seed, stream) always gives the same numbers, whichever thread draws them
+    class rng_stream
+    {
+        std::uint64_t M_seed, M_stream, M_index;
+        philox::block M_block;
+        std::size_t M_used;
+
+      public:
+        rng_stream(const std::uint64_t &seed, const std::uint64_t &stream);
+        [[nodiscard]] std::uint32_t next_u32();
+        [[nodiscard]] std::uint64_t next_u64();
+        // uniform in [0, 1) with 53 random bits
+        [[nodiscard]] double uniform();
+    };
+
+    // process-wide source of seeds for simulations whose request carries none: a single `std::random_device` read at start-up,
+    // then distinct seeds from a counter, so nothing reaches the kernel per measurement
+    class rng
+    {
+        std::uint64_t M_base;
+        std::atomic<std::uint64_t> M_next;
+
+        rng();
+
+      public:
+        // stream ids at and above this are used by `sample`, one per shot, below it by measurements, one per collapse
+        static constexpr std::uint64_t shot_streams = 1ULL << 63;
+
+        rng(const rng &) = delete;
+        rng &operator=(const rng &) = delete;
+
+        [[nodiscard]] static rng &get();
+        [[nodiscard]] std::uint64_t fresh_seed();
+    };
+}
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @file response.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./response.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+
+namespace simulator
+{
+    // bytes per number of a section, the unit a big-endian host has to reverse
+    static std::size_t word_size(const response::section_type &type)
+    {
+        switch (type)
+        {
+        case response::section_type::COMPLEX128:
+        case response::section_type::FLOAT64:
+        case response::section_type::INDEXED_FLOAT64:
+            return 8;
+        case response::section_type::COMPLEX64:
+            return 4;
+        default:
+            return 1;
+        }
+    }
+
+    static void put_le(std::string &__s, std::uint64_t v, const std::size_t &bytes)
+    {
+        for (std::size_t i = 0; i < bytes; i++, v >>= 8)
+            __s.push_back(static_cast<char>(v & 0xFF));
+    }
+
+    static std::size_t align8(const std::size_t &x)
+    {
+        return (x + 7) & ~static_cast<std::size_t>(7);
+    }
+
+    response::response(const bool &binary)
+        : M_binary(binary) {}
+
+    const bool &response::is_binary() const
+    {
+        return this->M_binary;
+    }
+
+    std::string &response::text(const std::string &name)
+    {
+        section s;
+        s.M_name = name;
+        this->M_sections.push_back(std::move(s));
+        return this->M_sections.back().M_text;
+    }
+
+    void response::array(const std::string &name, const section_type &type, const void *data, const std::size_t &size, std::shared_ptr<const void> owner)
+    {
+        if (!this->M_binary)
+        {
+            std::fprintf(stderr, "error: array section '%s' in a text response.\n", name.c_str());
+            std::exit(EXIT_FAILURE);
+        }
+        section s;
+        s.M_name = name;
+        s.M_type = type;
+        s.M_data = data;
+        s.M_size = size;
+        s.M_owner = std::move(owner);
+        this->M_sections.push_back(std::move(s));
+    }
+
+    const char *response::content_type() const
+    {
+        return this->M_binary ? "application/octet-stream" : "text/plain";
+    }
+
+    std::string response::header() const
+    {
+        std::string h("QVB1");
+        const std::size_t head = 16 + response::entry_size * this->M_sections.size();
+        put_le(h, response::version, 4);
+        put_le(h, this->M_sections.size(), 4);
+        put_le(h, head, 4);
+
+        std::size_t offset = head;
+        for (const section &s : this->M_sections)
+        {
+            const std::size_t size = s.M_type == section_type::TEXT ? s.M_text.size() : s.M_size;
+            std::string name = s.M_name.substr(0, response::name_size - 1);
+            name.resize(response::name_size, '\0');
+            h.append(name);
+            put_le(h, static_cast<std::uint32_t>(s.M_type), 4);
+            put_le(h, 0, 4);
+            put_le(h, offset, 8);
+            put_le(h, size, 8);
+            offset = align8(offset + size);
+        }
+        return h;
+    }
+
+    std::size_t response::size() const
+    {
+        std::size_t total = this->M_binary ? 16 + response::entry_size * this->M_sections.size() : 0;
+        for (const section &s : this->M_sections)
+        {
+            if (!this->M_binary)
+                total += s.M_name.size() + 1 + s.M_text.size();
+            else
+                total = align8(total) + (s.M_type == section_type::TEXT ? s.M_text.size() : s.M_size);
+        }
+        return total;
+    }
+
+    bool response::write(const std::size_t &offset, const std::function<bool(const char *, const std::size_t &)> &sink) const
+    {
+        static const char zeros[8] = {};
+        std::size_t pos = 0;
+        // passes the part of `p` at or after `offset`, a big-endian host reverses every `word`-byte number on the way
+        auto emit = [&](const char *p, const std::size_t &n, const std::size_t &word) -> bool
+        {
+            const std::size_t skip = offset > pos ? std::min(offset - pos, n) : 0;
+            pos += n;
+            if (skip == n)
+                return true;
+            if (word <= 1 || std::endian::native == std::endian::little)
+                return sink(p + skip, n - skip);
+
+            char buf[1ULL << 12];
+            for (std::size_t b = skip - skip % word; b < n; b += sizeof(buf))
+            {
+                const std::size_t len = std::min(sizeof(buf), n - b);
+                for (std::size_t w = 0; w < len; w += word)
+                    std::reverse_copy(p + b + w, p + b + w + word, buf + w);
+                const std::size_t lead = b < skip ? skip - b : 0;
+                if (!sink(buf + lead, len - lead))
+                    return false;
+            }
+            return true;
+        };
+
+        if (!this->M_binary)
+        {
+            for (const section &s : this->M_sections)
+                if (!emit(s.M_name.data(), s.M_name.size(), 1) || !emit("\n", 1, 1) || !emit(s.M_text.data(), s.M_text.size(), 1))
+                    return false;
+            return true;
+        }
+
+        const std::string head = this->header();
+        if (!emit(head.data(), head.size(), 1))
+            return false;
+        for (const section &s : this->M_sections)
+        {
+            if (!emit(zeros, align8(pos) - pos, 1))
+                return false;
+            const bool ok = s.M_type == section_type::TEXT ? emit(s.M_text.data(), s.M_text.size(), 1)
+                                                           : emit(static_cast<const char *>(s.M_data), s.M_size, word_size(s.M_type));
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,71 @@
+/**
+ * @file response.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_RESPONSE
+#define SIMULATOR_RESPONSE
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace simulator
+{
+    // the reply to one request as a list of named sections, sent either in the text format (the name on its own line, then the
+    // section's lines) or, when the client asks for it, as a binary document:
+    //   header   "QVB1", u32 version, u32 section count, u32 header size (header + table, bytes)
+    //   table    one 40-byte entry per section: name (16 bytes, NUL padded), u32 type, u32 reserved, u64 offset, u64 size
+    //   payload  the sections in order, each starting at its offset (a multiple of 8) from the beginning of the document
+    // every number is little-endian, amplitudes are interleaved real/imaginary pairs
+    class response
+    {
+      public:
+        enum class section_type : std::uint32_t
+        {
+            TEXT = 0,           // the section's lines, exactly as in the text format
+            COMPLEX128 = 1,     // complex<double> amplitudes
+            COMPLEX64 = 2,      // complex<float> amplitudes
+            FLOAT64 = 3,        // doubles
+            INDEXED_FLOAT64 = 4 // (u64 index, double) pairs
+        };
+        static constexpr std::uint32_t version = 1;
+        static constexpr std::size_t name_size = 16, entry_size = 40;
+
+      private:
+        struct section
+        {
+            std::string M_name;
+            section_type M_type = section_type::TEXT;
+            std::string M_text;
+            // array sections are sent straight from `M_data`, `M_owner` keeps it alive until the reply has been written
+            const void *M_data = nullptr;
+            std::size_t M_size = 0;
+            std::shared_ptr<const void> M_owner;
+        };
+
+        bool M_binary;
+        std::vector<section> M_sections;
+
+        [[nodiscard]] std::string header() const;
+
+      public:
+        explicit response(const bool &binary);
+        [[nodiscard]] const bool &is_binary() const;
+        // starts a text section and returns its body, the lines are appended to it
+        std::string &text(const std::string &name);
+        // a raw array section of `size` bytes, binary responses only
+        void array(const std::string &name, const section_type &type, const void *data, const std::size_t &size, std::shared_ptr<const void> owner);
+        [[nodiscard]] const char *content_type() const;
+        // total size in bytes, once every section has been added
+        [[nodiscard]] std::size_t size() const;
+        // passes bytes [offset, size()) to `sink` piece by piece, false as soon as `sink` fails
+        bool write(const std::size_t &offset, const std::function<bool(const char *, const std::size_t &)> &sink) const;
+    };
+}
+
+#endif
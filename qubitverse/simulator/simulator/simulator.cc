@@ -5,9 +5,19 @@
  */
 
 #include <iostream>
+#include <cctype>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <type_traits>
 #include "../gates/gates.hh"
+#include "../kernels/kernels.hh"
+#include "../threading/thread_pool.hh"
 #include "../lexer/lexer.hh"
 #include "../parser/parser.hh"
+#include "../optimizer/optimizer.hh"
+#include "../analysis/entanglement.hh"
+#include "../response/response.hh"
 #include "../dep/httplib.h"
 
 double deg_to_rad(const double &deg)
@@ -15,19 +25,286 @@ double deg_to_rad(const double &deg)
     return deg * (M_PI / 180.0);
 }
 
-void set_quantum_states(const simulator::qubit &q, std::string &__s, const std::string &gate)
+template <typename QUBIT>
+void set_quantum_states(const QUBIT &q, simulator::response &__out, const std::string &gate)
 {
-    const simulator::qubit::complex *vec_space = q.get_qubits();
+    if (__out.is_binary())
+    {
+        // the snapshot shares the amplitudes, they are sent as they are and only copied if a later gate writes to them
+        auto snap = std::make_shared<typename QUBIT::snapshot>(q.take_snapshot());
+        const auto type = std::is_same_v<typename QUBIT::complex, std::complex<float>> ? simulator::response::section_type::COMPLEX64 : simulator::response::section_type::COMPLEX128;
+        __out.array(gate, type, snap->get_qubits(), snap->get_size() * sizeof(typename QUBIT::complex), snap);
+        return;
+    }
+    const typename QUBIT::complex *vec_space = q.get_qubits();
     std::stringstream ss;
-    ss << gate << "\n";
     for (std::size_t i = 0; i < q.get_size(); i++)
     {
         ss << i << "=" << vec_space[i] << "\n";
     }
-    __s.append(ss.str());
+    __out.text(gate).append(ss.str());
+}
+
+// request options, sent as `key:value` lines between `n` and the first gate
+struct run_options
+{
+    bool M_trace = true; // trace:0|1, emit the state-vector after every gate
+    std::size_t M_fuse = 3; // fuse:N, widest block of fused gates without a trace (0 = no fusion, 1 = single-qubit chains only)
+    bool M_single = false; // precision:single|double, simulate with complex<float> amplitudes (half the memory and bandwidth)
+    std::size_t M_shots = 0; // shots:N, histogram of N <= max_shots outcomes sampled from the final state, without collapsing it
+    std::vector<simulator::pauli_term> M_observable; // pauli:coefficient:string, repeatable, one term of the observable each
+    std::vector<simulator::cost_term> M_cost; // cost:weight:bits, repeatable, weight times the product of the bits set to 1 in `bits`
+    std::vector<std::size_t> M_marginals; // marginal:bits, repeatable, distribution of the qubits set to 1 in `bits` (bit k = qubit k)
+    bool M_pairs = false; // pairs:0|1, concurrence and mutual information of every pair of qubits
+    double M_min_probability = 0.0; // minProbability:P, the prob section leaves out basis states less likely than P
+    std::size_t M_top_k = 0; // topK:N, the prob section lists only the N most likely basis states, most likely first (0 = all)
+    std::vector<std::pair<std::size_t, std::size_t>> M_ranges; // range:first:last, repeatable, basis states [first, last) of the prob section
+    bool M_binary = false; // format:text|binary, see simulator::response, an `Accept: application/octet-stream` header also picks binary
+    std::uint64_t M_seed = 0; // seed:N, makes measurements and the sampled histogram reproducible (random when not given)
+};
+
+// stores why a request is rejected in `__err`, always false so that a check can `return reject(...)`
+template <typename... ARGS>
+bool reject(std::string &__err, const char *fmt, const ARGS &...args)
+{
+    if constexpr (sizeof...(ARGS) == 0)
+        __err = fmt;
+    else
+    {
+        char buf[512];
+        std::snprintf(buf, sizeof(buf), fmt, args...);
+        __err = buf;
+    }
+    return false;
+}
+
+// the whole of `__v` as a number, a value with anything left over (a typo, a second number) is an error rather than a prefix
+bool option_double(const std::string &key, const std::string &__v, double &__out, std::string &__err)
+{
+    char *end = nullptr;
+    __out = std::strtod(__v.c_str(), &end);
+    if (__v.empty() || *end != '\0' || !std::isfinite(__out))
+        return reject(__err, "value '%s' of option '%s' is not a number", __v.c_str(), key.c_str());
+    return true;
+}
+
+bool option_unsigned(const std::string &key, const std::string &__v, std::uint64_t &__out, std::string &__err)
+{
+    char *end = nullptr;
+    __out = std::strtoull(__v.c_str(), &end, 10);
+    if (__v.empty() || *end != '\0' || __v[0] == '-')
+        return reject(__err, "value '%s' of option '%s' is not a non-negative integer", __v.c_str(), key.c_str());
+    return true;
+}
+
+// fills `opts` from the request, false with the reason in `__err` when an option is malformed (the request is answered with 400)
+bool read_options(const simulator::parser &p, run_options &opts, std::string &__err)
+{
+    if (p.has_option("trace") && !p.get_option("trace").empty())
+        opts.M_trace = p.get_option("trace").back() != "0";
+    if (p.has_option("fuse") && !p.get_option("fuse").empty())
+    {
+        std::uint64_t k = 0;
+        if (!option_unsigned("fuse", p.get_option("fuse").back(), k, __err))
+            return false;
+        opts.M_fuse = k < simulator::optimizer::max_block_qubits ? k : simulator::optimizer::max_block_qubits;
+    }
+    if (p.has_option("pauli"))
+    {
+        // values alternate coefficient, string: character k of the string acts on qubit k, missing trailing qubits are I
+        const std::vector<std::string> &vals = p.get_option("pauli");
+        if (vals.size() % 2 != 0)
+            return reject(__err, "every pauli term needs a coefficient and a string");
+        for (std::size_t k = 0; k < vals.size(); k += 2)
+        {
+            simulator::pauli_term term;
+            if (!option_double("pauli", vals[k], term.M_coefficient, __err))
+                return false;
+            const std::string &ops = vals[k + 1];
+            if (ops.size() > p.get_no_qubits())
+                return reject(__err, "pauli string '%s' is longer than the %zu-qubit system", ops.c_str(), p.get_no_qubits());
+            for (std::size_t q = 0; q < ops.size(); q++)
+            {
+                const char c = std::toupper(ops[q]);
+                if (c != 'I' && c != 'X' && c != 'Y' && c != 'Z')
+                    return reject(__err, "unknown pauli operator '%c' in '%s'", ops[q], ops.c_str());
+                term.M_x |= static_cast<std::size_t>(c == 'X' || c == 'Y') << q;
+                term.M_z |= static_cast<std::size_t>(c == 'Z' || c == 'Y') << q;
+            }
+            opts.M_observable.push_back(term);
+        }
+    }
+    if (p.has_option("cost"))
+    {
+        // values alternate weight, bits: character k of `bits` is 1 when qubit k is in the product, "0" is a constant
+        const std::vector<std::string> &vals = p.get_option("cost");
+        if (vals.size() % 2 != 0)
+            return reject(__err, "every cost term needs a weight and a bit string");
+        for (std::size_t k = 0; k < vals.size(); k += 2)
+        {
+            simulator::cost_term term;
+            if (!option_double("cost", vals[k], term.M_weight, __err))
+                return false;
+            const std::string &bits = vals[k + 1];
+            if (bits.size() > p.get_no_qubits() || bits.find_first_not_of("01") != std::string::npos)
+                return reject(__err, "cost term '%s' is not a bit string of at most %zu bits", bits.c_str(), p.get_no_qubits());
+            for (std::size_t q = 0; q < bits.size(); q++)
+                term.M_mask |= static_cast<std::size_t>(bits[q] == '1') << q;
+            opts.M_cost.push_back(term);
+        }
+    }
+    for (const std::string &bits : p.get_option("marginal"))
+    {
+        if (bits.size() > p.get_no_qubits() || bits.find_first_not_of("01") != std::string::npos)
+            return reject(__err, "marginal '%s' is not a bit string of at most %zu bits", bits.c_str(), p.get_no_qubits());
+        std::size_t mask = 0;
+        for (std::size_t q = 0; q < bits.size(); q++)
+            mask |= static_cast<std::size_t>(bits[q] == '1') << q;
+        if (std::popcount(mask) > static_cast<int>(simulator::qubit::max_joint_qubits))
+            return reject(__err, "marginal '%s' spans %d qubits, at most %zu are supported", bits.c_str(), std::popcount(mask), simulator::qubit::max_joint_qubits);
+        opts.M_marginals.push_back(mask);
+    }
+    if (p.has_option("minProbability") && !p.get_option("minProbability").empty() && !option_double("minProbability", p.get_option("minProbability").back(), opts.M_min_probability, __err))
+        return false;
+    if (p.has_option("topK") && !p.get_option("topK").empty())
+    {
+        std::uint64_t k = 0;
+        if (!option_unsigned("topK", p.get_option("topK").back(), k, __err))
+            return false;
+        opts.M_top_k = k;
+    }
+    if (p.has_option("range"))
+    {
+        const std::vector<std::string> &vals = p.get_option("range");
+        if (vals.size() % 2 != 0)
+            return reject(__err, "every range needs a first and a last index");
+        for (std::size_t k = 0; k < vals.size(); k += 2)
+        {
+            std::uint64_t first = 0, last = 0;
+            if (!option_unsigned("range", vals[k], first, __err) || !option_unsigned("range", vals[k + 1], last, __err))
+                return false;
+            opts.M_ranges.emplace_back(first, last);
+        }
+    }
+    if (p.has_option("pairs") && !p.get_option("pairs").empty())
+        opts.M_pairs = p.get_option("pairs").back() != "0";
+    if (p.has_option("shots") && !p.get_option("shots").empty())
+    {
+        std::uint64_t shots = 0;
+        if (!option_unsigned("shots", p.get_option("shots").back(), shots, __err))
+            return false;
+        if (shots > simulator::qubit::max_shots)
+            return reject(__err, "%llu shots requested, at most %zu are supported", static_cast<unsigned long long>(shots), simulator::qubit::max_shots);
+        opts.M_shots = shots;
+    }
+    if (p.has_option("seed") && !p.get_option("seed").empty())
+    {
+        if (!option_unsigned("seed", p.get_option("seed").back(), opts.M_seed, __err))
+            return false;
+    }
+    else
+        opts.M_seed = simulator::rng::get().fresh_seed();
+    if (p.has_option("format") && !p.get_option("format").empty())
+    {
+        const std::string &format = p.get_option("format").back();
+        if (format != "text" && format != "binary")
+            return reject(__err, "unknown format '%s', expected 'text' or 'binary'", format.c_str());
+        opts.M_binary = format == "binary";
+    }
+    if (p.has_option("precision") && !p.get_option("precision").empty())
+    {
+        const std::string &precision = p.get_option("precision").back();
+        if (precision != "single" && precision != "double")
+            return reject(__err, "unknown precision '%s', expected 'single' or 'double'", precision.c_str());
+        opts.M_single = precision == "single";
+    }
+    return true;
+}
+
+// the prob section: `i=p` for every basis state in the requested ranges at least as likely as `M_min_probability`, or for the
+// `M_top_k` most likely of them, the probabilities are read window by window and never held all at once
+// a binary response carries every probability as one float64 array when nothing is left out, else (index, probability) pairs
+template <typename QUBIT>
+void append_probabilities(const QUBIT &q, simulator::response &__out, const run_options &opts)
+{
+    // clamped, sorted and merged, so that no basis state is listed twice
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    for (const auto &[first, last] : opts.M_ranges)
+        if (std::min(last, q.get_size()) > first)
+            ranges.emplace_back(first, std::min(last, q.get_size()));
+    if (opts.M_ranges.empty())
+        ranges.emplace_back(0, q.get_size());
+    std::sort(ranges.begin(), ranges.end());
+    std::size_t merged = 0;
+    for (std::size_t k = 1; k < ranges.size(); k++)
+    {
+        if (ranges[k].first <= ranges[merged].second)
+            ranges[merged].second = std::max(ranges[merged].second, ranges[k].second);
+        else
+            ranges[++merged] = ranges[k];
+    }
+    ranges.resize(ranges.empty() ? 0 : merged + 1);
+
+    using entry = std::pair<std::size_t, double>;
+    static_assert(sizeof(entry) == 16 && sizeof(std::size_t) == 8, "entries are sent as u64, float64 pairs");
+    auto pairs = std::make_shared<std::vector<entry>>();
+    auto send_pairs = [&]()
+    { __out.array("prob", simulator::response::section_type::INDEXED_FLOAT64, pairs->data(), pairs->size() * sizeof(entry), pairs); };
+
+    if (__out.is_binary() && opts.M_top_k == 0 && opts.M_min_probability <= 0.0 && ranges.size() == 1 && ranges[0].first == 0 && ranges[0].second == q.get_size())
+    {
+        auto probs = std::make_shared<std::vector<double>>(q.get_size());
+        q.get_probabilities(probs->data(), 0, q.get_size());
+        __out.array("prob", simulator::response::section_type::FLOAT64, probs->data(), probs->size() * sizeof(double), probs);
+        return;
+    }
+
+    char buf[64];
+    if (opts.M_top_k > 0)
+    {
+        std::vector<std::pair<std::size_t, double>> top, part;
+        for (const auto &[first, last] : ranges)
+        {
+            q.top_probabilities(part, opts.M_top_k, opts.M_min_probability, first, last);
+            top.insert(top.end(), part.begin(), part.end());
+        }
+        std::stable_sort(top.begin(), top.end(), [](const auto &a, const auto &b)
+                         { return a.second > b.second; });
+        top.resize(std::min(top.size(), opts.M_top_k));
+        if (__out.is_binary())
+        {
+            *pairs = std::move(top);
+            return send_pairs();
+        }
+        std::string &sec = __out.text("prob");
+        for (const auto &[i, p] : top)
+            sec.append(buf, std::snprintf(buf, sizeof(buf), "%zu=%g\n", i, p));
+        return;
+    }
+
+    std::string *sec = __out.is_binary() ? nullptr : &__out.text("prob");
+
+    std::vector<double> window(std::min<std::size_t>(q.get_size(), 1ULL << 16));
+    for (const auto &[first, last] : ranges)
+        for (std::size_t b = first; b < last; b += window.size())
+        {
+            const std::size_t e = std::min(last, b + window.size());
+            q.get_probabilities(window.data(), b, e);
+            for (std::size_t i = b; i < e; i++)
+                if (window[i - b] >= opts.M_min_probability)
+                {
+                    if (sec)
+                        sec->append(buf, std::snprintf(buf, sizeof(buf), "%zu=%g\n", i, window[i - b]));
+                    else
+                        pairs->emplace_back(i, window[i - b]);
+                }
+        }
+    if (!sec)
+        send_pairs();
 }
 
-std::string get_quantum_info(const std::size_t &nQ, const std::vector<std::unique_ptr<simulator::ast_node>> &gates, const char &operation)
+template <typename QUBIT>
+void get_quantum_info(const std::size_t &nQ, const std::vector<std::unique_ptr<simulator::ast_node>> &gates, const char &operation, const run_options &opts, simulator::response &ret_val)
 {
     /*
     operation:
@@ -35,11 +312,21 @@ std::string get_quantum_info(const std::size_t &nQ, const std::vector<std::uniqu
     1 -> prob (0, 1)
     2 -> measure (0, 1, 2)
     */
-    simulator::qubit qsys(nQ);
-    std::string ret_val;
+    QUBIT qsys(nQ);
+    qsys.seed(opts.M_seed);
+    // nothing reads the intermediate states, so runs of low-qubit gates can be applied tile by tile
+    if (!opts.M_trace)
+        qsys.begin_batch();
+
+    // without a trace only the final state is emitted, which is what lets the optimizer merge gates
+    auto trace = [&](const std::string &gate)
+    {
+        if (opts.M_trace)
+            set_quantum_states(qsys, ret_val, gate);
+    };
 
     std::puts("System is on initial state:");
-    set_quantum_states(qsys, ret_val, "+"); // + indicates initial state
+    trace("+"); // + indicates initial state
     for (const std::unique_ptr<simulator::ast_node> &i : gates)
     {
         if (i->get_gate_type() == simulator::gate_type::SINGLE_GATE)
@@ -49,79 +336,79 @@ std::string get_quantum_info(const std::size_t &nQ, const std::vector<std::uniqu
             {
                 std::printf("Applying Identity Gate on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_identity(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "X")
             {
                 std::printf("Applying Pauli-X Gate on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_pauli_x(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "Y")
             {
                 std::printf("Applying Pauli-Y Gate on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_pauli_y(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "Z")
             {
                 std::printf("Applying Pauli-Z Gate on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_pauli_z(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "H")
             {
                 std::printf("Applying Hadamard Gate on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_hadamard(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "S")
             {
                 std::printf("Applying Phase Shift Gate by pi/2 on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_phase_pi_2_shift(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "T")
             {
                 std::printf("Applying Phase Shift Gate by pi/4 on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_phase_pi_4_shift(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "P")
             {
                 std::printf("Applying General Phase Shift Gate by %lf rad on Qubit %zu:\n", deg_to_rad(casted->M_theta), casted->M_qubit);
                 qsys.apply_phase_general_shift(deg_to_rad(casted->M_theta), casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "Rx")
             {
                 std::printf("Applying Rotation-X Gate by %lf rad on Qubit %zu:\n", deg_to_rad(casted->M_theta), casted->M_qubit);
                 qsys.apply_rotation_x(deg_to_rad(casted->M_theta), casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "Ry")
             {
                 std::printf("Applying Rotation-Y Gate by %lf rad on Qubit %zu:\n", deg_to_rad(casted->M_theta), casted->M_qubit);
                 qsys.apply_rotation_y(deg_to_rad(casted->M_theta), casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "Rz")
             {
                 std::printf("Applying Rotation-Z Gate by %lf rad on Qubit %zu:\n", deg_to_rad(casted->M_theta), casted->M_qubit);
                 qsys.apply_rotation_z(deg_to_rad(casted->M_theta), casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "V")
             {
                 std::printf("Applying V Gate on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_v(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
             else if (casted->M_gate == "adjV")
             {
                 std::printf("Applying V^-1 Gate on Qubit %zu:\n", casted->M_qubit);
                 qsys.apply_adj_v(casted->M_qubit);
-                set_quantum_states(qsys, ret_val, casted->M_gate);
+                trace(casted->M_gate);
             }
         }
         else if (i->get_gate_type() == simulator::gate_type::CNOT_GATE)
@@ -129,100 +416,182 @@ std::string get_quantum_info(const std::size_t &nQ, const std::vector<std::uniqu
             auto *casted = dynamic_cast<simulator::ast_cnot_gate_node *>(i.get());
             std::printf("Applying CNOT Gate [Control Qubit: %zu, Target Qubit: %zu]:\n", casted->M_control, casted->M_target);
             qsys.apply_cnot(casted->M_control, casted->M_target);
-            set_quantum_states(qsys, ret_val, "cnot");
+            trace("cnot");
         }
         else if (i->get_gate_type() == simulator::gate_type::CZ_GATE)
         {
             auto *casted = dynamic_cast<simulator::ast_cz_gate_node *>(i.get());
             std::printf("Applying CZ Gate [Control Qubit: %zu, Target Qubit: %zu]:\n", casted->M_control, casted->M_target);
             qsys.apply_cz(casted->M_control, casted->M_target);
-            set_quantum_states(qsys, ret_val, "cz");
+            trace("cz");
         }
         else if (i->get_gate_type() == simulator::gate_type::SWAP_GATE)
         {
             auto *casted = dynamic_cast<simulator::ast_swap_gate_node *>(i.get());
             std::printf("Applying SWAP Gate [Qubit1: %zu, Qubit2: %zu]:\n", casted->M_qubit1, casted->M_qubit2);
             qsys.apply_swap(casted->M_qubit1, casted->M_qubit2);
-            set_quantum_states(qsys, ret_val, "swap");
+            trace("swap");
         }
         else if (i->get_gate_type() == simulator::gate_type::MEASURE_NTH)
         {
             auto *casted = dynamic_cast<simulator::ast_measure_nth_node *>(i.get());
             std::printf("Measuring the Qubit %zu:\n", casted->M_qubit);
             qsys.measure_nth_qubit(casted->M_qubit);
-            set_quantum_states(qsys, ret_val, "measureNth");
+            trace("measureNth");
+        }
+        else if (i->get_gate_type() == simulator::gate_type::DIAGONAL_RUN)
+        {
+            auto *casted = dynamic_cast<simulator::ast_diagonal_run_node *>(i.get());
+            std::printf("Applying %zu merged Diagonal Gates on %zu Qubits:\n", casted->M_merged, casted->M_qubits.size());
+            qsys.apply_diagonal_run(casted->M_qubits, casted->M_phases);
+        }
+        else if (i->get_gate_type() == simulator::gate_type::FUSED_GATE)
+        {
+            auto *casted = dynamic_cast<simulator::ast_fused_gate_node *>(i.get());
+            std::printf("Applying %zu fused Gates on Qubit %zu:\n", casted->M_merged, casted->M_qubit);
+            qsys.apply_unitary(casted->M_matrix, casted->M_qubit);
+        }
+        else if (i->get_gate_type() == simulator::gate_type::BLOCK_GATE)
+        {
+            auto *casted = dynamic_cast<simulator::ast_block_gate_node *>(i.get());
+            std::printf("Applying %zu fused Gates on %zu Qubits:\n", casted->M_merged, casted->M_qubits.size());
+            qsys.apply_unitary(casted->M_qubits, casted->M_matrix);
         }
     }
-
-    ret_val.append("bloch\n");
-    for (std::size_t i = 0; i < qsys.no_of_qubits(); i++)
+    if (!opts.M_trace)
     {
-        double bloch[3];
-        qsys.get_bloch_data(bloch, i);
-        ret_val.append(std::to_string(i) + "=" + std::to_string(bloch[0]) + "," + std::to_string(bloch[1]) + "," + std::to_string(bloch[2]) + "\n");
+        qsys.end_batch();
+        set_quantum_states(qsys, ret_val, "final");
     }
 
-    if (operation == '0')
-        return ret_val;
-    else if (operation == '1')
-    {
-        ret_val.append("prob\n");
-        double *vec_prob = new double[qsys.get_size()]();
-        std::puts("Computing Probabilities:");
-        qsys.compute_probabilities(vec_prob);
+    std::string &bloch_sec = ret_val.text("bloch");
+    std::vector<std::array<double, 3>> bloch;
+    qsys.get_bloch_data(bloch);
+    for (std::size_t i = 0; i < bloch.size(); i++)
+        bloch_sec.append(std::to_string(i) + "=" + std::to_string(bloch[i][0]) + "," + std::to_string(bloch[i][1]) + "," + std::to_string(bloch[i][2]) + "\n");
 
-        std::stringstream ss;
-        for (std::size_t i = 0; i < qsys.get_size(); i++)
+    if (!opts.M_observable.empty())
+    {
+        // one line per term: k=<P_k> (coefficient not applied), then sum=<observable>
+        std::printf("Computing %zu Pauli Expectation Values:\n", opts.M_observable.size());
+        std::string &sec = ret_val.text("expectation");
+        std::vector<double> values;
+        qsys.expectation(opts.M_observable, values);
+        char buf[32];
+        double total = 0.0;
+        for (std::size_t k = 0; k < values.size(); k++)
         {
-            ss << i << "=" << vec_prob[i] << "\n";
+            std::snprintf(buf, sizeof(buf), "%.17g", values[k]);
+            sec.append(std::to_string(k) + "=" + buf + "\n");
+            total += opts.M_observable[k].M_coefficient * values[k];
         }
-        ret_val.append(ss.str());
-        delete[] vec_prob;
-        return ret_val;
+        std::snprintf(buf, sizeof(buf), "%.17g", total);
+        sec.append(std::string("sum=") + buf + "\n");
     }
-    else if (operation == '2')
+
+    if (!opts.M_cost.empty())
     {
-        ret_val.append("prob\n");
-        double *vec_prob = new double[qsys.get_size()]();
-        std::puts("Computing Probabilities:");
-        qsys.compute_probabilities(vec_prob);
+        // value=<cost> over the measured bitstring
+        std::printf("Computing the Expected Cost of %zu Terms:\n", opts.M_cost.size());
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.17g", qsys.diagonal_cost(opts.M_cost));
+        ret_val.text("cost").append(std::string("value=") + buf + "\n");
+    }
 
-        std::stringstream ss;
-        for (std::size_t i = 0; i < qsys.get_size(); i++)
-        {
-            ss << i << "=" << vec_prob[i] << "\n";
-        }
+    if (opts.M_pairs)
+    {
+        // one line per pair a < b: a,b=concurrence,mutual information (bits)
+        std::printf("Computing pairwise entanglement:\n");
+        std::string &sec = ret_val.text("pairs");
+        std::vector<std::array<std::complex<double>, 16>> rdms;
+        qsys.get_pair_rdms(rdms);
+        for (std::size_t a = 0, k = 0; a < qsys.no_of_qubits(); a++)
+            for (std::size_t b = a + 1; b < qsys.no_of_qubits(); b++, k++)
+                sec.append(std::to_string(a) + "," + std::to_string(b) + "=" + std::to_string(simulator::entanglement::concurrence(rdms[k])) + "," + std::to_string(simulator::entanglement::mutual_information(rdms[k])) + "\n");
+    }
 
-        std::puts("Measuring the states:");
-        ss << "measure\n"
-           << qsys.measure() << "\n";
+    for (const std::size_t &mask : opts.M_marginals)
+    {
+        // one section per marginal: j=P(outcome j), bit t of j is the t-th lowest requested qubit
+        std::printf("Computing the Marginal Distribution of %d Qubits:\n", std::popcount(mask));
+        std::string &sec = ret_val.text("marginal");
+        std::vector<double> hist;
+        qsys.marginal_probabilities(mask, hist);
+        char buf[64];
+        for (std::size_t j = 0; j < hist.size(); j++)
+            sec.append(buf, std::snprintf(buf, sizeof(buf), "%zu=%g\n", j, hist[j]));
+    }
 
-        ret_val.append(ss.str());
-        delete[] vec_prob;
-        return ret_val;
+    if (opts.M_shots > 0)
+    {
+        std::printf("Sampling %zu shots:\n", opts.M_shots);
+        std::string &sec = ret_val.text("counts");
+        for (const auto &[outcome, count] : qsys.sample(opts.M_shots, opts.M_seed))
+            sec.append(std::to_string(outcome) + "=" + std::to_string(count) + "\n");
+    }
+
+    if (operation == '1' || operation == '2')
+    {
+        std::puts("Computing Probabilities:");
+        append_probabilities(qsys, ret_val, opts);
+    }
+    if (operation == '2')
+    {
+        std::puts("Measuring the states:");
+        ret_val.text("measure").append(std::to_string(qsys.measure()) + "\n");
     }
 }
 
+// the reply to a request that cannot be simulated, nothing of it has been run
+void bad_request(httplib::Response &res, const std::string &why)
+{
+    std::fprintf(stderr, "error: %s.\n", why.c_str());
+    res.status = 400;
+    res.set_header("Access-Control-Allow-Origin", "https://qubitverse-lpa4.onrender.com");
+    res.set_content("error: " + why + "\n", "text/plain");
+}
+
 int main(void)
 {
+    std::printf("Using %s gate kernels on %zu threads\n", simulator::kernels::isa_name(simulator::kernels::selected_isa()), simulator::thread_pool::get().get_threads());
+
     httplib::Server svr;
     svr.Post("/api/endpoint", [](const httplib::Request &req, httplib::Response &res)
              {
                 char feature = req.body[0];
                 simulator::lexer lex;
-                lex.perform(req.body.substr(1));
-
                 simulator::parser parser;
-                parser.perform(lex.get());
+                if (!lex.perform(req.body.substr(1)) || !parser.perform(lex.get()))
+                    return bad_request(res, "malformed request");
                 parser.debug_print();
 
-                std::string reply = get_quantum_info(parser.get_no_qubits(), parser.get(), feature);
+                run_options opts;
+                std::string error;
+                if (!read_options(parser, opts, error))
+                    return bad_request(res, error);
+                if (!opts.M_trace)
+                {
+                    if (opts.M_fuse > 0)
+                        simulator::optimizer::fuse_single_qubit(parser.get(), parser.get_no_qubits());
+                    if (opts.M_fuse > 1)
+                        simulator::optimizer::fuse_blocks(parser.get(), opts.M_fuse);
+                    simulator::optimizer::merge_diagonal_runs(parser.get());
+                }
+
+                const bool binary = opts.M_binary || req.get_header_value("Accept").find("application/octet-stream") != std::string::npos;
+                auto reply = std::make_shared<simulator::response>(binary);
+                if (opts.M_single)
+                    get_quantum_info<simulator::qubit_f>(parser.get_no_qubits(), parser.get(), feature, opts, *reply);
+                else
+                    get_quantum_info<simulator::qubit>(parser.get_no_qubits(), parser.get(), feature, opts, *reply);
 
                 // Set CORS header
                 res.set_header("Access-Control-Allow-Origin", "https://qubitverse-lpa4.onrender.com");
 
-                // Set the response content as plain text
-                res.set_content(reply, "text/plain");
+                // written straight from the sections, the binary arrays are never copied into one buffer
+                res.set_content_provider(reply->size(), reply->content_type(), [reply](std::size_t offset, std::size_t, httplib::DataSink &sink)
+                                         { return reply->write(offset, [&sink](const char *p, const std::size_t &n)
+                                                               { return sink.write(p, n); }); });
                 std::puts("---------------------------------------------------------------------"); });
 
     // Start the server on port 9080
@@ -0,0 +1,154 @@
+/**
+ * @file thread_pool.cc
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#include "./thread_pool.hh"
+#include <cstdlib>
+
+namespace simulator
+{
+    // set on pool workers, so that nested jobs do not wait on themselves
+    static thread_local bool tl_in_pool = false;
+
+    thread_pool::thread_pool()
+        : M_job(nullptr), M_count(0), M_chunk(0), M_generation(0), M_pending(0), M_threads(1), M_threshold(default_threshold), M_stop(false)
+    {
+        std::size_t n = std::thread::hardware_concurrency();
+        if (const char *env = std::getenv("QUBITVERSE_THREADS"))
+        {
+            const long long v = std::atoll(env);
+            if (v > 0)
+                n = static_cast<std::size_t>(v);
+        }
+        this->M_threads = n == 0 ? 1 : n;
+        this->spawn();
+    }
+
+    void thread_pool::spawn()
+    {
+        this->M_stop = false;
+        this->M_workers.reserve(this->M_threads - 1);
+        // the submitting thread always works on chunk 0, so only `M_threads - 1` workers are needed
+        // workers start from the current generation, otherwise a respawned pool would rerun the last (finished) job
+        for (std::size_t i = 1; i < this->M_threads; i++)
+            this->M_workers.emplace_back(&thread_pool::worker_loop, this, i, this->M_generation);
+    }
+
+    void thread_pool::join()
+    {
+        {
+            std::lock_guard<std::mutex> lk(this->M_lock);
+            this->M_stop = true;
+        }
+        this->M_wake.notify_all();
+        for (std::thread &t : this->M_workers)
+            t.join();
+        this->M_workers.clear();
+    }
+
+    void thread_pool::worker_loop(const std::size_t &id, const std::size_t &generation)
+    {
+        tl_in_pool = true;
+        std::size_t seen = generation;
+        for (;;)
+        {
+            const job_type *job;
+            {
+                std::unique_lock<std::mutex> lk(this->M_lock);
+                this->M_wake.wait(lk, [&]
+                                  { return this->M_stop || this->M_generation != seen; });
+                if (this->M_stop)
+                    return;
+                seen = this->M_generation;
+                job = this->M_job;
+            }
+
+            this->run_chunk(*job, id);
+
+            std::lock_guard<std::mutex> lk(this->M_lock);
+            if (--this->M_pending == 0)
+                this->M_done.notify_one();
+        }
+    }
+
+    void thread_pool::run_chunk(const job_type &job, const std::size_t &id) const
+    {
+        const std::size_t begin = id * this->M_chunk;
+        if (begin >= this->M_count)
+            return;
+        const std::size_t end = begin + this->M_chunk < this->M_count ? begin + this->M_chunk : this->M_count;
+        job(begin, end);
+    }
+
+    thread_pool &thread_pool::get()
+    {
+        static thread_pool pool;
+        return pool;
+    }
+
+    void thread_pool::set_threads(const std::size_t &n)
+    {
+        std::lock_guard<std::mutex> lk(this->M_submit);
+        this->join();
+        this->M_threads = n == 0 ? 1 : n;
+        this->spawn();
+    }
+
+    const std::size_t &thread_pool::get_threads() const
+    {
+        return this->M_threads;
+    }
+
+    void thread_pool::set_threshold(const std::size_t &n)
+    {
+        this->M_threshold = n;
+    }
+
+    const std::size_t &thread_pool::get_threshold() const
+    {
+        return this->M_threshold;
+    }
+
+    void thread_pool::parallel_for(const std::size_t &_count, const std::size_t &_grain, const job_type &job)
+    {
+        if (_count == 0)
+            return;
+        if (this->M_threads == 1 || _count < this->M_threshold || tl_in_pool)
+        {
+            job(0, _count);
+            return;
+        }
+
+        // one job at a time, concurrent HTTP requests queue up here and each one gets every core
+        std::lock_guard<std::mutex> submit(this->M_submit);
+
+        const std::size_t grain = _grain == 0 ? 1 : _grain;
+        std::size_t chunk = (_count + this->M_threads - 1) / this->M_threads;
+        chunk = ((chunk + grain - 1) / grain) * grain;
+        {
+            std::lock_guard<std::mutex> lk(this->M_lock);
+            this->M_job = &job;
+            this->M_count = _count;
+            this->M_chunk = chunk;
+            this->M_pending = this->M_workers.size();
+            this->M_generation++;
+        }
+        this->M_wake.notify_all();
+
+        tl_in_pool = true;
+        this->run_chunk(job, 0);
+        tl_in_pool = false;
+
+        std::unique_lock<std::mutex> lk(this->M_lock);
+        this->M_done.wait(lk, [this]
+                          { return this->M_pending == 0; });
+        this->M_job = nullptr;
+    }
+
+    thread_pool::~thread_pool()
+    {
+        this->join();
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * @file thread_pool.hh
+ * @license This file is licensed under the GNU GENERAL PUBLIC LICENSE Version 3, 29 June 2007. You may obtain a copy of this license at https://www.gnu.org/licenses/gpl-3.0.en.html.
+ * @author Tushar Chaurasia (Dark-CodeX)
+ */
+
+#ifndef SIMULATOR_THREAD_POOL
+#define SIMULATOR_THREAD_POOL
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace simulator
+{
+    // process-wide pool of persistent worker threads, the state-vector kernels split their index space over it
+    // the number of threads is taken from the environment variable `QUBITVERSE_THREADS` (default: all hardware threads)
+    class thread_pool
+    {
+      public:
+        using job_type = std::function<void(const std::size_t &, const std::size_t &)>;
+
+        // below this many work items a job runs serially on the calling thread, waking the workers would cost more than it saves
+        static constexpr std::size_t default_threshold = 1ULL << 15;
+
+      private:
+        std::vector<std::thread> M_workers;
+        std::mutex M_lock, M_submit;
+        std::condition_variable M_wake, M_done;
+        const job_type *M_job;
+        std::size_t M_count, M_chunk, M_generation, M_pending;
+        std::size_t M_threads, M_threshold;
+        bool M_stop;
+
+        thread_pool();
+        void spawn();
+        void join();
+        void worker_loop(const std::size_t &id, const std::size_t &generation);
+        void run_chunk(const job_type &job, const std::size_t &id) const;
+
+      public:
+        thread_pool(const thread_pool &) = delete;
+        thread_pool &operator=(const thread_pool &) = delete;
+
+        [[nodiscard]] static thread_pool &get();
+        void set_threads(const std::size_t &n);
+        [[nodiscard]] const std::size_t &get_threads() const;
+        void set_threshold(const std::size_t &n);
+        [[nodiscard]] const std::size_t &get_threshold() const;
+
+        // calls `job(begin, end)` on disjoint sub-ranges covering [0, _count), every `begin` is a multiple of `_grain`
+        // jobs submitted from inside a worker, or smaller than the threshold, run serially on the calling thread
+        void parallel_for(const std::size_t &_count, const std::size_t &_grain, const job_type &job);
+        ~thread_pool();
+    };
+}
+
+#endif